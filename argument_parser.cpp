@@ -1,13 +1,417 @@
 #include "argument_parser.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <system_error>
+#include <thread>
 #include <utility>
 
+#ifdef _WIN32
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#define environ _environ
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
 using ap = utils::argument_parser;
 
+namespace {
+[[noreturn]] void throw_option_name_error(utils::option_name_error error, const std::string& name) {
+    switch (error) {
+        case utils::option_name_error::short_not_alpha:
+            throw utils::UsageException("Illegal name, letter of  '" + name + "' is a non alpha-character");
+        case utils::option_name_error::long_not_alpha:
+            throw utils::UsageException("Illegal name, first letter of '" + name + "' is a non alpha-character");
+        case utils::option_name_error::long_illegal_character:
+            throw utils::UsageException("'" + name + "' contains other characters than a-zA-Z0-9_-");
+        default:
+            throw utils::UsageException(
+                    "Given option name has to be '-[a-zA-Z0-9]' or '--[a-zA-Z0-9][a-zA-Z0-9_-]*'");
+    }
+}
+
+// a word of a bitset, missing words are zero
+inline std::uint64_t word_of(const std::vector<std::uint64_t>& bits, std::size_t index) {
+    return (index < bits.size()) ? bits[index] : 0;
+}
+
+// Appends `help` to a row whose help column starts at `indent`, continued lines are indented.
+// Lines are broken at spaces before `width`, words longer than a line are kept whole.
+void append_wrapped(std::string& text, std::string_view help, std::size_t indent, std::size_t width) {
+    const std::size_t minimum_width = 16;
+    if ((width == 0) || (width < indent + minimum_width)) {
+        text += help;
+        return;
+    }
+    const auto available = width - indent;
+    while (help.size() > available) {
+        auto cut = help.rfind(' ', available);
+        if ((cut == std::string_view::npos) || (cut == 0)) {
+            cut = help.find(' ', available);
+            if (cut == std::string_view::npos) {
+                break;
+            }
+        }
+        text += help.substr(0, cut);
+        text += '\n';
+        text.append(indent, ' ');
+        help.remove_prefix(cut);
+        while (!help.empty() && (help[0] == ' ')) {
+            help.remove_prefix(1);
+        }
+    }
+    text += help;
+}
+
+void throw_if_failed(const utils::argument_parser::ParseStatus& status) {
+    if (status.code() == utils::parse_error::no_arguments) {
+        throw utils::UsageException(status.message());
+    } else if (!status.ok()) {
+        throw utils::ParsingException(status.message());
+    }
+}
+}
+
+char* ap::TextArena::reserve(std::size_t size) {
+    while ((m_block < m_blocks.size()) && (m_blocks[m_block].capacity - m_used < size)) {
+        ++m_block;
+        m_used = 0;
+    }
+    if (m_block == m_blocks.size()) {
+        const auto capacity = std::max<std::size_t>(size, 4096);
+        m_blocks.push_back({std::unique_ptr<char[]>(new char[capacity]), capacity});
+    }
+    return m_blocks[m_block].data.get() + m_used;
+}
+
+ap::ArgumentViewType ap::TextArena::commit(std::size_t used) {
+    const ArgumentViewType text(m_blocks[m_block].data.get() + m_used, used);
+    m_used += used;
+    return text;
+}
+
+void ap::TextArena::clear() {
+    m_block = 0;
+    m_used = 0;
+}
+
+std::string_view ap::StringPool::intern(std::string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+    const auto match = m_texts.find(text);
+    if (match != m_texts.end()) {
+        return *match;
+    }
+    std::copy(text.begin(), text.end(), m_arena.reserve(text.size()));
+    return *m_texts.insert(m_arena.commit(text.size())).first;
+}
+
+// the text of a response file, which is empty and not open if it could not be read
+class ap::ResponseFile {
+public:
+    explicit ResponseFile(const std::string& path) {
+#ifdef _WIN32
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return;
+        }
+        m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+#else
+        const int descriptor = ::open(path.c_str(), O_RDONLY);
+        struct stat status{};
+        if ((descriptor < 0) || (::fstat(descriptor, &status) != 0)) {
+            if (descriptor >= 0) {
+                ::close(descriptor);
+            }
+            return;
+        }
+        const auto size = static_cast<std::size_t>(status.st_size);
+        if (size > 0) {
+            void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (data == MAP_FAILED) {
+                ::close(descriptor);
+                return;
+            }
+            ::madvise(data, size, MADV_SEQUENTIAL);
+            m_data = static_cast<const char*>(data);
+            m_size = size;
+        }
+        ::close(descriptor);
+#endif
+        m_is_open = true;
+    }
+
+    ResponseFile(const ResponseFile&) = delete;
+
+    ResponseFile& operator=(const ResponseFile&) = delete;
+
+    ~ResponseFile() {
+#ifndef _WIN32
+        if (m_data != nullptr) {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+#endif
+    }
+
+    inline std::string_view text() const { return {m_data, m_size}; }
+
+    inline bool is_open() const { return m_is_open; }
+
+private:
+    const char* m_data{nullptr};
+    std::size_t m_size{0};
+    bool m_is_open{false};
+#ifdef _WIN32
+    std::string m_buffer;
+#endif
+};
+
+class ap::ArgumentStream {
+public:
+    ArgumentStream(const ArgumentSource& argv, Result& result, ArgumentCountType maximum_depth)
+            : m_argv(argv), m_result(result), m_maximum_depth(maximum_depth) {}
+
+    // the arguments of a command line, the line counts as no response file
+    ArgumentStream(std::string_view command_line, Result& result, ArgumentCountType maximum_depth)
+            : m_argv(m_no_arguments), m_current(0), m_result(result), m_maximum_depth(maximum_depth + 1),
+              m_is_command_line(true) {
+        m_files.push_back({command_line, 0});
+    }
+
+    // False after the last argument or an error, `@file` is replaced by the arguments in file if
+    // `expand` is set.
+    bool next(ArgumentViewType& argument, bool expand) {
+        while (!failed()) {
+            if (!m_files.empty()) {
+                const bool is_word = m_is_command_line && (m_files.size() == 1);
+                if (is_word) {
+                    m_index = m_words;
+                }
+                if (!next_token(m_files.back(), argument)) {
+                    m_files.pop_back();
+                    continue;
+                }
+                m_words += is_word ? 1 : 0;
+            } else if (m_current < m_argv.size()) {
+                m_index = m_current;
+                argument = m_argv[m_current++];
+            } else {
+                return false;
+            }
+            if (!expand || (argument.size() < 2) || (argument[0] != '@')) {
+                return true;
+            }
+            open(argument.substr(1));
+        }
+        return false;
+    }
+
+    // arguments left on the command line, without the contents of response files
+    inline std::size_t remaining() const { return m_argv.size() - m_current; }
+
+    // position of the last argument on the command line, arguments read from a response file
+    // share the position of the file
+    inline std::size_t index() const { return m_index; }
+
+    inline bool failed() const { return m_error.code != parse_error::none; }
+
+    // why the arguments could not be read
+    inline const ParseError& error() const { return m_error; }
+
+private:
+    struct OpenFile {
+        std::string_view text;
+        std::size_t position;
+    };
+
+    void fail(parse_error code, ArgumentViewType argument) {
+        m_error.code = code;
+        m_error.argument_index = m_index;
+        m_error.argument = argument;
+    }
+
+    void open(ArgumentViewType path) {
+        if (m_files.size() >= m_maximum_depth) {
+            fail(parse_error::nested_response_file, path);
+            m_error.expected = m_maximum_depth;
+            return;
+        }
+        auto file = std::make_shared<const ResponseFile>(ArgumentType(path));
+        if (!file->is_open()) {
+            fail(parse_error::unreadable_response_file, path);
+            return;
+        }
+        m_files.push_back({file->text(), 0});
+        m_result.m_response_files.push_back(std::move(file));
+    }
+
+    static bool is_separator(char c) {
+        return std::isspace(static_cast<unsigned char>(c)) != 0;
+    }
+
+    static bool is_continuation(std::string_view text, std::size_t position) {
+        return (text[position] == '\\') && (position + 1 < text.size()) && (text[position + 1] == '\n');
+    }
+
+    // Splits like a POSIX shell without any expansion: whitespace separates tokens, quotes group
+    // them, a backslash escapes the next character and `#` starts a comment at the beginning of
+    // a token. Tokens without quotes or escapes are views into the text, all others are
+    // unquoted into the arena of the result.
+    bool next_token(OpenFile& file, ArgumentViewType& token) {
+        const auto text = file.text;
+        auto position = file.position;
+        while (position < text.size()) {
+            if (is_separator(text[position])) {
+                ++position;
+            } else if (is_continuation(text, position)) {
+                position += 2;
+            } else if (text[position] == '#') {
+                while ((position < text.size()) && (text[position] != '\n')) {
+                    ++position;
+                }
+            } else {
+                break;
+            }
+        }
+        if (position == text.size()) {
+            file.position = position;
+            return false;
+        }
+
+        const auto start = position;
+        while ((position < text.size()) && !is_separator(text[position]) &&
+               (text[position] != '\'') && (text[position] != '"') && (text[position] != '\\')) {
+            ++position;
+        }
+        if ((position == text.size()) || is_separator(text[position])) {
+            token = text.substr(start, position - start);
+            file.position = position;
+            return true;
+        }
+
+        // the unquoted token is never longer than its text
+        std::size_t open_quote = ArgumentViewType::npos;
+        const auto end = unquote(text, start, nullptr, open_quote);
+        if (open_quote != ArgumentViewType::npos) {
+            fail(parse_error::missing_quote, text.substr(start, 64));
+            m_error.detail = text.substr(open_quote, 1);
+            return false;
+        }
+        char* output = m_result.m_arena.reserve(end - start);
+        const auto length = unquote(text, start, output, open_quote);
+        token = m_result.m_arena.commit(length);
+        file.position = end;
+        return true;
+    }
+
+    // Writes the unquoted token at `position` to `output` if given, returns the end of the
+    // token or else the length of the unquoted token. `open_quote` is the position of a quote
+    // that is not closed.
+    static std::size_t unquote(std::string_view text, std::size_t position, char* output, std::size_t& open_quote) {
+        std::size_t length = 0;
+        auto append = [&](char c) {
+            if (output != nullptr) {
+                output[length] = c;
+            }
+            ++length;
+        };
+
+        char quote = 0;
+        for (; position < text.size(); ++position) {
+            const char c = text[position];
+            if (quote == '\'') {
+                if (c == quote) {
+                    quote = 0;
+                } else {
+                    append(c);
+                }
+            } else if (quote == '"') {
+                if (c == quote) {
+                    quote = 0;
+                } else if (is_continuation(text, position)) {
+                    ++position;
+                } else if ((c == '\\') && (position + 1 < text.size()) &&
+                           (std::strchr("$`\"\\", text[position + 1]) != nullptr)) {
+                    append(text[++position]);
+                } else {
+                    append(c);
+                }
+            } else if (is_separator(c)) {
+                break;
+            } else if ((c == '\'') || (c == '"')) {
+                quote = c;
+                open_quote = position;
+            } else if (c == '\\') {
+                if (is_continuation(text, position)) {
+                    ++position;
+                } else if (position + 1 < text.size()) {
+                    append(text[++position]);
+                }
+            } else {
+                append(c);
+            }
+        }
+        if (quote == 0) {
+            open_quote = ArgumentViewType::npos;
+        }
+        return (output != nullptr) ? length : position;
+    }
+
+    static const ArgumentSource m_no_arguments;
+
+    const ArgumentSource& m_argv;
+    std::size_t m_current{1};
+    std::size_t m_index{0};
+    std::size_t m_words{0};  // read from the command line
+    Result& m_result;
+    ArgumentCountType m_maximum_depth;
+    bool m_is_command_line{false};
+    std::vector<OpenFile> m_files;
+    ParseError m_error;
+};
+
+const ap::ArgumentSource ap::ArgumentStream::m_no_arguments{0, nullptr};
+
+ap::argument_parser(const utils::option_table_view& table) {
+    m_options.reserve(table.number_of_specs);
+    m_option_texts.reserve(table.number_of_specs);
+    for (std::size_t i = 0; i < table.number_of_specs; ++i) {
+        const auto& spec = table.specs[i];
+        Option option(spec.number_of_arguments);
+        if (spec.number_of_arguments == 0) {
+            option.set_value_type<bool>();  // flags, as in add_flag()
+        }
+        for (const auto name : spec.names) {
+            if (!name.empty()) {
+                option.set_name(name.substr((name.size() == 2) ? 1 : 2));
+                break;
+            }
+        }
+        m_option_texts.push_back({{}, spec.help, {}, &spec});
+        if (!spec.default_value.empty()) {
+            option.set_default({StorageValueType(spec.default_value)});
+        }
+        m_options.emplace_back(std::move(option));
+    }
+    m_option_index.set_table(table);
+}
+
 void ap::set_help_info(
         const ap::HelpTextType& preamble,
         const ap::HelpTextType& epilog) {
+    invalidate_help();
     m_help_epilog = epilog;
     m_help_preamble = preamble;
 }
@@ -15,11 +419,13 @@ void ap::set_help_info(
 void ap::set_program_info(
         const ap::HelpTextType& program_name,
         const ap::HelpTextType& version) {
+    invalidate_help();
     m_program_name = program_name;
     m_program_version = version;
 }
 
 void ap::set_required_positionals(ap::ArgumentCountType minimum_positionals) {
+    invalidate_help();
     if (minimum_positionals > m_number_of_maximum_positionals) {
         throw UsageException(
                 "Number of minimum positionals must not be less than the number of maximum positionals");
@@ -28,6 +434,7 @@ void ap::set_required_positionals(ap::ArgumentCountType minimum_positionals) {
 }
 
 void ap::set_allowed_positionals(ap::ArgumentCountType maximum_positionals) {
+    invalidate_help();
     if (m_number_of_minimum_positionals > maximum_positionals) {
         throw UsageException(
                 "Number of minimum positionals must not be less than the number of maximum positionals");
@@ -37,29 +444,250 @@ void ap::set_allowed_positionals(ap::ArgumentCountType maximum_positionals) {
 
 void ap::set_positional_help(const ap::HelpTextType& help,
                                                  const ap::HelpTextType& meta_var) {
+    invalidate_help();
     m_positional_help = help;
     m_positional_meta_var = meta_var;
 }
 
+void ap::set_positional_callback(ap::ValueCallback callback) {
+    m_positional_callback = std::move(callback);
+}
+
 void ap::reset_storage() {
-    for (auto& option : m_options) {
-        option.reset_storage();
-    }
-    m_positionals.clear();
+    m_result.clear();
 }
 
 void ap::parse(int argc, char** argv) {
-    ArgumentListType arguments(argv, argv + argc);
-    parse(arguments);
+    parse(argc, const_cast<const char**>(argv));
 }
 
 void ap::parse(int argc, const char** argv) {
-    ArgumentListType arguments(argv, argv + argc);
-    parse(arguments);
+    if (argc > 0) {
+        set_program_name_from_argv(argv[0]);
+    }
+    parse(ArgumentSource(argc, argv), m_result);
+}
+
+void ap::parse(const ap::ArgumentListType& argv) {
+    if (!argv.empty()) {
+        set_program_name_from_argv(argv[0]);
+    }
+    m_result.m_copied_arguments.emplace_back(argv);
+    parse(ArgumentSource(m_result.m_copied_arguments.back()), m_result);
+}
+
+void ap::parse(int argc, const char* const* argv, ap::Result& result) const {
+    result.clear();
+    parse(ArgumentSource(argc, argv), result);
+}
+
+void ap::parse(const ap::ArgumentListType& argv, ap::Result& result) const {
+    result.clear();
+    parse(ArgumentSource(argv), result);
+}
+
+void ap::parse(ap::ArgumentListType&& argv, ap::Result& result) const {
+    result.clear();
+    result.m_copied_arguments.emplace_back(std::move(argv));
+    parse(ArgumentSource(result.m_copied_arguments.back()), result);
+}
+
+ap::ParseStatus ap::try_parse(int argc, const char* const* argv, ap::Result& result, bool collect_all) const {
+    ParseStatus status;
+    status.m_is_collecting_all = collect_all;
+    result.clear();
+    parse(ArgumentSource(argc, argv), result, status);
+    return status;
+}
+
+ap::ParseStatus ap::try_parse(const ap::ArgumentListType& argv, ap::Result& result, bool collect_all) const {
+    ParseStatus status;
+    status.m_is_collecting_all = collect_all;
+    result.clear();
+    parse(ArgumentSource(argv), result, status);
+    return status;
+}
+
+ap::ParseStatus ap::try_parse(ap::ArgumentListType&& argv, ap::Result& result, bool collect_all) const {
+    ParseStatus status;
+    status.m_is_collecting_all = collect_all;
+    result.clear();
+    result.m_copied_arguments.emplace_back(std::move(argv));
+    parse(ArgumentSource(result.m_copied_arguments.back()), result, status);
+    return status;
+}
+
+ap::BatchResultList ap::parse_batch(const std::vector<ap::ArgumentListType>& argument_lists,
+                                    unsigned number_of_threads) const {
+    BatchResultList entries;
+    parse_batch(argument_lists, entries, number_of_threads);
+    return entries;
+}
+
+void ap::parse_batch(const std::vector<ap::ArgumentListType>& argument_lists, ap::BatchResultList& entries,
+                     unsigned number_of_threads) const {
+    entries.resize(argument_lists.size());
+
+    // small chunks keep the threads busy when the lists differ in length
+    const std::size_t chunk_size = 64;
+    std::atomic<std::size_t> next_chunk{0};
+    auto work = [&]() {
+        for (auto first = next_chunk.fetch_add(chunk_size); first < argument_lists.size();
+             first = next_chunk.fetch_add(chunk_size)) {
+            const auto last = std::min(first + chunk_size, argument_lists.size());
+            for (auto i = first; i < last; ++i) {
+                auto& entry = entries[i];
+                entry.result.clear();
+                entry.error.clear();
+                try {
+                    ParseStatus status;
+                    parse(ArgumentSource(argument_lists[i]), entry.result, status);
+                    if (!status.ok()) {
+                        entry.error = status.message();
+                    }
+                } catch (const std::exception& e) {
+                    entry.error = e.what();
+                } catch (...) {
+                    entry.error = "unknown error while parsing";  // thrown by a callback, must not end the thread
+                }
+            }
+        }
+    };
+
+    if (number_of_threads == 0) {
+        number_of_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const auto number_of_chunks = (argument_lists.size() + chunk_size - 1) / chunk_size;
+    const auto number_of_workers = std::min<std::size_t>(number_of_threads, number_of_chunks);
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < number_of_workers; ++i) {
+        try {
+            workers.emplace_back(work);
+        } catch (const std::system_error&) {
+            break;  // the started threads and the calling one share the work
+        }
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ap::set_environment_variable(const ap::OptionNameType& name, const std::string& variable) {
+    invalidate_help();
+    if (variable.empty() || (variable.find('=') != std::string::npos)) {
+        throw UsageException("Illegal name of an environment variable '" + variable + "'");
+    }
+    if (m_environment_index.count(variable) != 0) {
+        throw UsageException("Environment variable '" + variable + "' is already bound to an option");
+    }
+    const auto position = static_cast<std::size_t>(&find_option(name) - m_options.data());
+    auto& texts = m_option_texts[position];
+    if (!texts.environment_variable.empty()) {
+        m_environment_index.erase(texts.environment_variable);
+    }
+    texts.environment_variable = m_texts.intern(variable);
+    m_environment_index.emplace(texts.environment_variable, position);
+}
+
+void ap::set_callback(const ap::OptionNameType& name, ap::ValueCallback callback) {
+    auto& option = find_option(name);
+    const auto position = m_option_index.find(normalize_option_name(name));
+    option.set_callback(std::move(callback));
+    if (std::find(m_bound_positions.begin(), m_bound_positions.end(), position) == m_bound_positions.end()) {
+        m_bound_positions.push_back(position);
+    }
+}
+
+void ap::add_subcommand(const std::string& name, const ap::HelpTextType& help, ap::SubcommandFactory factory) {
+    invalidate_help();
+    if (name.empty() || (name[0] == '-')) {
+        throw UsageException("Illegal name of a subcommand '" + name + "'");
+    }
+    for (const auto& subcommand : m_subcommands) {
+        if (subcommand->name == name) {
+            throw UsageException("Subcommand '" + name + "' already exists");
+        }
+    }
+    m_subcommands.emplace_back(new Subcommand{name, help, std::move(factory), {}, nullptr});
+}
+
+const ap& ap::get_subcommand_parser(const std::string& name) const {
+    const auto subcommand = find_subcommand(name);
+    if (subcommand == nullptr) {
+        throw UsageException("Unknown subcommand '" + name + "'");
+    }
+    return build_subcommand(*subcommand);
 }
 
-void ap::set_program_name_from_argv(const ap::ArgumentType& argv0) {
+ap::ArgumentViewType ap::get_subcommand() const {
+    return m_result.get_subcommand();
+}
+
+const ap::Result& ap::get_subcommand_result() const {
+    return m_result.get_subcommand_result();
+}
+
+const ap::Subcommand* ap::find_subcommand(ap::ArgumentViewType name) const {
+    for (const auto& subcommand : m_subcommands) {
+        if (subcommand->name == name) {
+            return subcommand.get();
+        }
+    }
+    return nullptr;
+}
+
+const ap& ap::build_subcommand(const ap::Subcommand& subcommand) const {
+    // parse() is const and may run on several threads, so the parser is built exactly once
+    std::call_once(subcommand.is_built, [&]() {
+        auto parser = std::make_unique<argument_parser>();
+        parser->set_program_info(m_program_name.empty() ? subcommand.name : m_program_name + " " + subcommand.name);
+        subcommand.factory(*parser);
+        subcommand.parser = std::move(parser);
+    });
+    return *subcommand.parser;
+}
+
+void ap::set_help_width(std::size_t width) {
+    invalidate_help();
+    m_help_width = width;
+}
+
+void ap::set_abbreviations(bool is_allowed) {
+    m_is_allowing_abbreviations = is_allowed;
+}
+
+std::vector<ap::OptionNameType> ap::complete(std::string_view prefix) const {
+    std::vector<OptionNameType> names;
+    if (prefix.empty() || (prefix == "-") || ((prefix.size() == 2) && (prefix[0] == '-') && (prefix[1] != '-'))) {
+        for (const char* letter = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"; *letter != 0; ++letter) {
+            const auto position = m_option_index.find(std::string_view(letter, 1));
+            if ((position != OptionIndex::npos) && !m_options[position].is_hidden() &&
+                ((prefix.size() < 2) || (prefix[1] == *letter))) {
+                names.push_back(std::string("-") + *letter);
+            }
+        }
+    }
+    if (prefix.empty() || (prefix == "-") || (prefix.substr(0, 2) == "--")) {
+        const auto candidates = m_option_index.find_prefix(prefix.substr(std::min<std::size_t>(prefix.size(), 2)));
+        for (auto iter = candidates.first; iter != candidates.second; ++iter) {
+            if (!m_options[iter->second].is_hidden()) {
+                names.push_back("--" + OptionNameType(iter->first));
+            }
+        }
+    }
+    return names;
+}
+
+void ap::set_response_files(bool is_enabled, ap::ArgumentCountType maximum_depth) {
+    m_is_expanding_response_files = is_enabled;
+    m_maximum_response_file_depth = maximum_depth;
+}
+
+void ap::set_program_name_from_argv(ap::ArgumentViewType argv0) {
     if (m_program_name.empty()) {
+        invalidate_help();
         m_program_name = argv0;
 #ifdef _WIN32
         auto name_start = std::find( m_program_name.rbegin(), m_program_name.rend(), '\\' );
@@ -72,65 +700,325 @@ void ap::set_program_name_from_argv(const ap::ArgumentType& argv0) {
     }
 }
 
-void ap::parse(const ap::ArgumentListType& argv) {
-    if (argv.empty()) {
-        throw UsageException("argument parser was called with zero arguments.");
+void ap::parse(const ap::ArgumentSource& argv, ap::Result& result) const {
+    ParseStatus status;
+    parse(argv, result, status);
+    throw_if_failed(status);
+}
+
+void ap::parse(const ap::ArgumentSource& argv, ap::Result& result, ap::ParseStatus& status) const {
+    if (argv.size() == 0) {
+        ParseError error;
+        error.code = parse_error::no_arguments;
+        error.parser = this;
+        status.report(error, true);
+        return;
+    }
+    result.m_program_name = argv[0];
+    ArgumentStream stream(argv, result, m_maximum_response_file_depth);
+    parse(stream, result, status);
+}
+
+void ap::parse_command_line(std::string_view command_line) {
+    // copied once, the arguments are views into the copy
+    char* copy = m_result.m_arena.reserve(command_line.size());
+    std::copy(command_line.begin(), command_line.end(), copy);
+    command_line = m_result.m_arena.commit(command_line.size());
+
+    ParseStatus status;
+    parse_command_line(command_line, m_result, status);
+    if (!m_result.m_program_name.empty()) {
+        set_program_name_from_argv(m_result.m_program_name);
     }
-    set_program_name_from_argv(argv[0]);
+    throw_if_failed(status);
+}
+
+void ap::parse_command_line(std::string_view command_line, ap::Result& result) const {
+    result.clear();
+    ParseStatus status;
+    parse_command_line(command_line, result, status);
+    throw_if_failed(status);
+}
+
+ap::ParseStatus ap::try_parse_command_line(std::string_view command_line, ap::Result& result,
+                                           bool collect_all) const {
+    ParseStatus status;
+    status.m_is_collecting_all = collect_all;
+    result.clear();
+    parse_command_line(command_line, result, status);
+    return status;
+}
+
+void ap::parse_command_line(std::string_view command_line, ap::Result& result, ap::ParseStatus& status) const {
+    ArgumentStream stream(command_line, result, m_maximum_response_file_depth);
+    if (!stream.next(result.m_program_name, false)) {
+        ParseError error = stream.error();
+        if (!stream.failed()) {
+            error.code = parse_error::no_arguments;
+        }
+        error.parser = this;
+        status.report(error, true);
+        return;
+    }
+    parse(stream, result, status);
+}
+
+void ap::parse(ap::ArgumentStream& stream, ap::Result& result, ap::ParseStatus& status, const ap* parent,
+               ap::Result* parent_result) const {
+    result.m_parser = this;
+    result.m_options.resize(m_options.size());
+    result.m_parsed_options.resize((m_options.size() + 63) / 64);
+    auto& positionals = result.m_positionals;
+    auto& values = result.m_values;
     bool positional_indicator_set{false};
 
-    for (ArgumentListType::size_type current = 1; current < argv.size(); ++current) {
-        ArgumentType arg = argv[current];
+    // the option to parse `name` and the result storing its values, npos if the name is unknown
+    struct Target {
+        const argument_parser* parser;
+        Result* result;
+        std::size_t position;
+
+        inline const Option& option() const { return parser->m_options[position]; }
+    };
+    // exact names go before abbreviations, the subcommand's before those of the parent
+    auto find_target = [&](std::string_view name, parse_error& error) -> Target {
+        if ((parent != nullptr) && (m_option_index.find(normalize_option_name(name)) == OptionIndex::npos)) {
+            if (parent->m_option_index.find(parent->normalize_option_name(name)) == OptionIndex::npos) {
+                const auto position = find_option_to_parse(name, error);
+                if ((position != OptionIndex::npos) || (error != parse_error::unknown_option)) {
+                    return {this, &result, position};
+                }
+            }
+            return {parent, parent_result, parent->find_option_to_parse(name, error)};
+        }
+        return {this, &result, find_option_to_parse(name, error)};
+    };
+    auto parse_target = [&](const Target& target, ParseError& error) {
+        if (!target.option().parse(values, target.result->m_options[target.position], error)) {
+            return false;
+        }
+        target.result->mark_parsed(target.position);
+        return true;
+    };
+
+    ArgumentViewType arg;
+    std::size_t index{0};
+    // records a problem of the current argument, false if parsing has to stop
+    auto report = [&](ParseError error) {
+        error.argument_index = index;
+        error.parser = this;
+        status.report(error);
+        return !status.is_done();
+    };
+    auto report_argument = [&](parse_error code, ArgumentViewType option = {}) {
+        ParseError error;
+        error.code = code;
+        error.argument = arg;
+        error.option = option;
+        return report(error);
+    };
+
+    while (stream.next(arg, m_is_expanding_response_files && !positional_indicator_set)) {
+        index = stream.index();
         if ((!positional_indicator_set) && (arg == "--")) {
             positional_indicator_set = true;
+        } else if (!m_subcommands.empty() && !positional_indicator_set && !arg.empty() && (arg[0] != '-')) {
+            const auto subcommand = find_subcommand(arg);
+            if (subcommand == nullptr) {
+                report_argument(parse_error::unknown_subcommand);
+                return;  // the remaining arguments belong to an unknown command
+            }
+            if (!result.m_subcommand_result) {
+                result.m_subcommand_result = std::make_unique<Result>();
+            }
+            auto& subcommand_result = *result.m_subcommand_result;
+            subcommand_result.clear();
+            subcommand_result.m_program_name = arg;
+            result.m_subcommand = arg;
+            build_subcommand(*subcommand).parse(stream, subcommand_result, status, this, &result);
+            if (status.is_done()) {
+                return;
+            }
+            break;  // all further arguments belong to the subcommand
         } else if (positional_indicator_set || (!arg.empty() && (arg[0] != '-'))) {
-            if (m_positionals.size() >= m_number_of_maximum_positionals) {
-                throw ParsingException("Found an additional positional argument '" + arg +
-                                       "', although maximum number of positional arguments is already reached.");
+            if (result.m_number_of_positionals >= m_number_of_maximum_positionals) {
+                if (!report_argument(parse_error::too_many_positionals)) {
+                    return;
+                }
+                continue;
+            }
+            ++result.m_number_of_positionals;
+            if (m_positional_callback) {
+                if (!m_positional_callback(arg) && !report_argument(parse_error::invalid_value)) {
+                    return;
+                }
+                continue;
             }
-            m_positionals.emplace_back(arg);
+            if (positionals.empty()) {  // only positionals can follow
+                positionals.reserve(std::min<std::size_t>(stream.remaining() + 1, m_number_of_maximum_positionals));
+            }
+            positionals.emplace_back(arg);
         } else if (is_short_option_name(arg) || is_long_option(arg)) {
-            if (!m_positionals.empty()) {
-                throw ParsingException("Found an option after a positional was given '" + arg + "'");
+            if (result.m_number_of_positionals != 0) {
+                if (!report_argument(parse_error::option_after_positional)) {
+                    return;
+                }
+                continue;
             }
 
             if (is_short_option_group_name(arg)) {
-                for (ArgumentType::size_type i = 1; i < arg.size(); ++i) {
+                for (ArgumentViewType::size_type i = 1; i < arg.size(); ++i) {
                     if (!std::isalpha(arg[i])) {
-                        throw ParsingException("only alpha chars are allowed for option sequences, not: " + arg);
+                        if (!report_argument(parse_error::invalid_option_group)) {
+                            return;
+                        }
+                        break;
+                    }
+                    ParseError error;
+                    const auto target = find_target(arg.substr(i, 1), error.code);
+                    values.clear();
+                    if (target.position == OptionIndex::npos) {
+                        if (!report_argument(error.code, arg.substr(i, 1))) {
+                            return;
+                        }
+                    } else if (!parse_target(target, error) && !report(error)) {
+                        return;
                     }
-                    auto& option = find_option_to_parse(std::string(1, arg[i]));
-                    option.parse({});
                 }
             } else {
                 auto name_value_pair = split_argument_text(arg);
-                StorageType values;
+                values.clear();
                 if (!name_value_pair.second.empty()) {
                     if (name_value_pair.second[0] == '=') {
-                        name_value_pair.second.erase(0, 1);
+                        name_value_pair.second.remove_prefix(1);
                     }
                     values.emplace_back(name_value_pair.second);
                 }
-                auto& option = find_option_to_parse(name_value_pair.first);
-                const auto missing_arguments = option.number_of_arguments() - values.size();
-                if ((missing_arguments > 0) && ((current + missing_arguments) < argv.size())) {
-                    std::copy_n(argv.begin() + (current + 1), missing_arguments, std::back_inserter(values));
-                    current += missing_arguments;
+                ParseError error;
+                const auto target = find_target(name_value_pair.first, error.code);
+                if (target.position == OptionIndex::npos) {
+                    if (!report_argument(error.code, name_value_pair.first)) {
+                        return;
+                    }
+                    continue;
+                }
+                ArgumentViewType value;
+                while ((values.size() < target.option().number_of_arguments()) &&
+                       stream.next(value, m_is_expanding_response_files)) {
+                    values.emplace_back(value);
+                }
+                if (stream.failed()) {
+                    break;
+                }
+                if (!parse_target(target, error) && !report(error)) {
+                    return;
                 }
-                option.parse(values);
             }
-        } else {
-            throw ParsingException("Unrecognized argument found: " + argv[current]);
+        } else if (!report_argument(parse_error::unrecognized_argument)) {
+            return;
         }
     }
+    if (stream.failed()) {
+        ParseError error = stream.error();
+        error.parser = this;
+        status.report(error, true);
+        return;
+    }
 
-    check_required_arguments();
-    check_xor_arguments();
+    parse_environment(result, status);
+    for (const auto position : m_bound_positions) {
+        ParseError error;
+        if (!status.is_done() && !result.m_options[position].is_parsed() && !m_options[position].apply_defaults(error)) {
+            error.parser = this;
+            status.report(error);
+        }
+    }
+    if (status.is_done()) {
+        return;
+    }
+    check_required_arguments(result, status);
+    if (status.is_done()) {
+        return;
+    }
+    check_constraints(result, status);
+}
+
+void ap::parse_environment(ap::Result& result, ap::ParseStatus& status) const {
+    if (m_environment_index.empty()) {
+        return;
+    }
+    for (char** entry = environ; (entry != nullptr) && (*entry != nullptr); ++entry) {
+        const std::string_view text(*entry);
+        const auto separator = text.find('=');
+        if (separator == std::string_view::npos) {
+            continue;
+        }
+        const auto match = m_environment_index.find(text.substr(0, separator));
+        if ((match != m_environment_index.end()) && !result.m_options[match->second].is_parsed()) {
+            parse_environment_value(match->second, match->first, text.substr(separator + 1), result, status);
+            if (result.m_options[match->second].is_parsed()) {
+                result.mark_parsed(match->second);
+            }
+            if (status.is_done()) {
+                return;
+            }
+        }
+    }
+}
+
+void ap::parse_environment_value(std::size_t position, std::string_view variable, std::string_view value,
+                                 ap::Result& result, ap::ParseStatus& status) const {
+    const auto& option = m_options[position];
+    auto& state = result.m_options[position];
+    auto& values = result.m_values;
+    values.clear();
+
+    // the environment may change after parsing
+    char* copy = result.m_arena.reserve(value.size());
+    std::copy(value.begin(), value.end(), copy);
+    value = result.m_arena.commit(value.size());
+    ParseError error;
+    bool is_valid{true};
+    if (option.number_of_arguments() == 0) {
+        bool is_set{false};
+        if (!Option::try_parse_value(value, is_set)) {
+            error.code = parse_error::invalid_value;
+            error.argument = value;
+            is_valid = false;
+        } else if (is_set) {
+            is_valid = option.parse(values, state, error);
+        }
+    } else if ((option.number_of_arguments() == 1) && !option.is_appending()) {
+        values.emplace_back(value);
+        is_valid = option.parse(values, state, error);
+    } else {
+        ArgumentStream words(value, result, 0);
+        ArgumentViewType word;
+        while (is_valid && words.next(word, false)) {
+            values.emplace_back(word);
+            if (values.size() == option.number_of_arguments()) {
+                is_valid = option.parse(values, state, error);
+                values.clear();
+            }
+        }
+        if (words.failed()) {
+            error = words.error();
+            is_valid = false;
+        } else if (is_valid && !values.empty()) {
+            is_valid = option.parse(values, state, error);  // reports the missing arguments
+        }
+    }
+    if (!is_valid) {
+        error.argument_index = ParseError::npos;
+        error.variable = variable;
+        error.parser = this;
+        status.report(error);
+    }
 }
 
 void ap::add_flag(const ap::OptionNameSetType& names,
                                       const ap::HelpTextType& help) {
-    add_option(names, 0, help, {}, {});
+    add_option<bool>(names, 0, help, {}, {});
 }
 
 void ap::add_option(const ap::OptionNameSetType& names,
@@ -157,6 +1045,14 @@ void ap::add_option(const ap::OptionNameSetType& names,
                                         const std::vector<ap::HelpTextType>& meta_vars,
                                         const ap::StorageType& default_values,
                                         const ap::ChoiceStorageType& choices) {
+    insert_option(names, Option(number_of_arguments, choices), help, meta_vars, default_values);
+}
+
+void ap::insert_option(const ap::OptionNameSetType& names, ap::Option option,
+                       const ap::HelpTextType& help,
+                       const ap::MetaVarListType& meta_vars,
+                       const ap::StorageType& default_values) {
+    invalidate_help();
     if (names.empty()) {
         throw UsageException("No option name was given");
     }
@@ -164,18 +1060,75 @@ void ap::add_option(const ap::OptionNameSetType& names,
     OptionNameSetType option_names;
     for (auto& name: names) {
         auto option_name = strictly_normalize_option_name(name);
-        if (has_option(option_name)) {
-            throw UsageException("Option '" + option_name + "' already exists");
+        if (m_option_index.find(option_name) != OptionIndex::npos) {
+            throw UsageException("Option '" + OptionNameType(option_name) + "' already exists");
         }
         option_names.emplace(option_name);
     }
 
-    auto option = Option(number_of_arguments, choices);
-    option.set_names(option_names);
-    option.set_help(help);
-    option.set_meta_vars(meta_vars);
+    add_option_texts(option, option_names, help, meta_vars);
     option.set_default(default_values);
-    m_options.emplace_back(option);
+    m_options.emplace_back(std::move(option));
+    for (const auto& option_name : option_names) {
+        m_option_index.insert(m_texts.intern(option_name), m_options.size() - 1);
+    }
+}
+
+void ap::add_option_texts(ap::Option& option, const ap::OptionNameSetType& names, std::string_view help,
+                          const ap::MetaVarListType& meta_vars) {
+    if ((!meta_vars.empty()) && (meta_vars.size() != option.number_of_arguments())) {
+        throw UsageException("number of meta vars does not match number of arguments");
+    }
+    std::string text;
+    for (const auto& name : names) {
+        text += (name.size() == 1) ? " -" : " --";
+        text += name;
+    }
+    if (!meta_vars.empty()) {
+        for (const auto& meta_var : meta_vars) {
+            text += " <";
+            text += meta_var;
+            text += '>';
+        }
+    } else {
+        for (ArgumentCountType i = 0; i < option.number_of_arguments(); ++i) {
+            text += " <ARG>";
+        }
+    }
+    option.set_name(names.empty() ? std::string_view() : m_texts.intern(*names.begin()));
+    m_option_texts.push_back({m_texts.intern(text), m_texts.intern(help), {}});
+}
+
+std::size_t ap::help_names_size(std::size_t position) const {
+    const auto* spec = m_option_texts[position].spec;
+    if (spec == nullptr) {
+        return m_option_texts[position].names.size();
+    }
+    std::size_t size = 0;
+    for (const auto name : spec->names) {
+        size += name.empty() ? 0 : name.size() + 1;
+    }
+    const auto meta_var_size = spec->meta_var.empty() ? 3 : spec->meta_var.size();
+    return size + spec->number_of_arguments * (meta_var_size + 3);
+}
+
+void ap::append_help_names(std::string& text, std::size_t position) const {
+    const auto* spec = m_option_texts[position].spec;
+    if (spec == nullptr) {
+        text += m_option_texts[position].names;
+        return;
+    }
+    for (const auto name : spec->names) {
+        if (!name.empty()) {
+            text += ' ';
+            text += name;
+        }
+    }
+    for (ArgumentCountType i = 0; i < spec->number_of_arguments; ++i) {
+        text += " <";
+        text += spec->meta_var.empty() ? "ARG" : spec->meta_var;
+        text += '>';
+    }
 }
 
 bool ap::has_option(const ap::OptionNameType& name) const {
@@ -183,42 +1136,113 @@ bool ap::has_option(const ap::OptionNameType& name) const {
     return iter != m_options.end();
 }
 
+ap::ArgumentCountType ap::number_of_arguments(const ap::OptionNameType& name) const {
+    return find_option(name).number_of_arguments();
+}
+
+bool ap::has_default(const ap::OptionNameType& name) const {
+    return find_option(name).has_default();
+}
+
+bool ap::has_callback(const ap::OptionNameType& name) const {
+    return find_option(name).has_callback();
+}
+
 bool ap::is_parsed(const ap::OptionNameType& name) const {
-    const auto& iter = find_option_iter(normalize_option_name(name));
-    return (iter != m_options.end()) && iter->is_parsed();
+    return is_parsed(m_result, name);
+}
+
+bool ap::is_parsed(const ap::Result& result, std::string_view name) const {
+    const auto position = m_option_index.find(normalize_option_name(name));
+    return (position != OptionIndex::npos) && result.state(position).is_parsed();
+}
+
+std::size_t ap::get_choice_index(const ap::OptionNameType& name) const {
+    return get_choice_index(m_result, name);
+}
+
+std::size_t ap::get_choice_index(const ap::Result& result, const ap::OptionNameType& name) const {
+    const auto position = find_option_position(name);
+    const auto& option = m_options[position];
+    if (option.number_of_arguments() != 1) {
+        throw UsageException("Invalid number of arguments used for getting the option");
+    }
+    if (!option.has_ordered_choices()) {
+        throw UsageException("Choices of option '" + name + "' are unordered, add them as OrderedChoiceStorageType");
+    }
+    return option.choice_index(result.state(position), 0);
+}
+
+std::vector<std::size_t> ap::get_choice_indices(const ap::OptionNameType& name) const {
+    return get_choice_indices(m_result, name);
+}
+
+std::vector<std::size_t> ap::get_choice_indices(const ap::Result& result, const ap::OptionNameType& name) const {
+    const auto position = find_option_position(name);
+    const auto& option = m_options[position];
+    if (!option.has_ordered_choices()) {
+        throw UsageException("Choices of option '" + name + "' are unordered, add them as OrderedChoiceStorageType");
+    }
+    const auto& state = result.state(position);
+    const auto count = option.active_size(state);
+    std::vector<std::size_t> indices;
+    indices.reserve(count);
+    for (StorageType::size_type i = 0; i < count; ++i) {
+        indices.push_back(option.choice_index(state, i));
+    }
+    return indices;
 }
 
 bool ap::has_positionals() const {
-    return (!m_positionals.empty());
+    return m_result.has_positionals();
 }
 
 const ap::StorageType& ap::get_positionals() const {
-    return m_positionals;
+    return m_result.get_positionals();
 }
 
-std::string ap::help() const {
-    std::vector<std::pair<std::string, std::string> > formatted_options;
+const ap::ArgumentViewListType& ap::get_positional_views() const {
+    return m_result.get_positional_views();
+}
 
-    size_t longest = 0;
+const std::string& ap::help() const {
+    std::lock_guard<std::mutex> lock(m_help_mutex);
+    if (!m_is_help_valid) {
+        m_help_text = render_help();
+        m_is_help_valid = true;
+    }
+    return m_help_text;
+}
 
-    for (const auto& option : m_options) {
-        if (!option.is_hidden()) {
-            auto option_names_help_pair = option.generate_help_text();
-            longest = std::max(longest, option_names_help_pair.first.length());
-            formatted_options.emplace_back(option_names_help_pair);
+std::string ap::render_help() const {
+    std::size_t longest = 0;
+    std::size_t number_of_rows = 0;
+    for (std::size_t i = 0; i < m_options.size(); ++i) {
+        if (!m_options[i].is_hidden()) {
+            longest = std::max(longest, help_names_size(i));
+            ++number_of_rows;
         }
     }
-    if (!m_positional_help.empty() && !m_positional_meta_var.empty()) {
-        formatted_options.emplace_back(" " + m_positional_meta_var, m_positional_help);
+    const bool has_positional_row = !m_positional_help.empty() && !m_positional_meta_var.empty();
+    if (has_positional_row) {
+        longest = std::max(longest, m_positional_meta_var.size() + 1);
     }
 
-    std::string text = "Usage of " + m_program_name;
+    std::string text;
+    // room for the rows with a line of help each, so that appending rarely reallocates
+    text.reserve(256 + m_help_preamble.size() + m_help_epilog.size() + number_of_rows * (longest + 2 + 80));
+    text += "Usage of ";
+    text += m_program_name;
     if (!m_program_version.empty()) {
-        text += " " + m_program_version;
+        text += ' ';
+        text += m_program_version;
     }
-    text += ":\n";
-    text += "  " + m_program_name + " [OPTION...]";
-    if (m_number_of_maximum_positionals > 0) {
+    text += ":\n  ";
+    text += m_program_name;
+    text += " [OPTION...]";
+    if (!m_subcommands.empty()) {
+        text += " <SUBCOMMAND> [ARGUMENTS...]";
+    } else if (m_number_of_maximum_positionals > 0) {
         if (m_positional_meta_var.empty()) {
             if (m_number_of_maximum_positionals == 1) {
                 text += " <POSITIONAL>";
@@ -229,25 +1253,64 @@ std::string ap::help() const {
                 text += " <POSITIONALS>";
             }
         } else {
-            text += " " + m_positional_meta_var;
+            text += ' ';
+            text += m_positional_meta_var;
         }
     }
     text += "\n\n";
     if (!m_help_preamble.empty()) {
-        text += m_help_preamble + "\n\n";
+        text += m_help_preamble;
+        text += "\n\n";
     }
+
     text += "Options:\n";
-    for (const auto& o : formatted_options) {
-        text += o.first + std::string(longest + 2 - o.first.length(), ' ') + o.second + "\n";
+    std::string help_text;  // of one option, reused
+    for (std::size_t i = 0; i < m_options.size(); ++i) {
+        if (!m_options[i].is_hidden()) {
+            const auto& texts = m_option_texts[i];
+            append_help_names(text, i);
+            text.append(longest + 2 - help_names_size(i), ' ');
+            help_text = texts.help;
+            m_options[i].append_help_properties(help_text, texts.environment_variable);
+            append_wrapped(text, help_text, longest + 2, m_help_width);
+            text += '\n';
+        }
     }
-    if (!m_help_epilog.empty()) {
-        text += "\n" + m_help_epilog;
+    if (has_positional_row) {
+        text += ' ';
+        text += m_positional_meta_var;
+        text.append(longest + 1 - m_positional_meta_var.size(), ' ');
+        append_wrapped(text, m_positional_help, longest + 2, m_help_width);
+        text += '\n';
     }
 
+    if (!m_subcommands.empty()) {
+        size_t longest_name = 0;
+        for (const auto& subcommand : m_subcommands) {
+            longest_name = std::max(longest_name, subcommand->name.length());
+        }
+        text += "\nSubcommands:\n";
+        for (const auto& subcommand : m_subcommands) {
+            text += ' ';
+            text += subcommand->name;
+            text.append(longest_name + 2 - subcommand->name.length(), ' ');
+            append_wrapped(text, subcommand->help, longest_name + 3, m_help_width);
+            text += '\n';
+        }
+    }
+    if (!m_help_epilog.empty()) {
+        text += '\n';
+        text += m_help_epilog;
+    }
     return text;
 }
 
+const std::string& ap::help(const std::string& subcommand) const {
+    return get_subcommand_parser(subcommand).help();
+}
+
 void ap::set_required(const ap::OptionNameSetType& names) {
+    invalidate_help();
     for (auto& option: m_options) {
         option.set_required(false);
     }
@@ -255,9 +1318,11 @@ void ap::set_required(const ap::OptionNameSetType& names) {
         auto& existing_option = find_option(name);
         existing_option.set_required(true);
     }
+    m_required_options = to_mask(names);
 }
 
 void ap::set_hidden(const ap::OptionNameSetType& names) {
+    invalidate_help();
     for (auto& option: m_options) {
         option.set_hidden(false);
     }
@@ -268,8 +1333,17 @@ void ap::set_hidden(const ap::OptionNameSetType& names) {
 }
 
 void ap::set_appending_arguments(const ap::OptionNameSetType& names) {
-    for (auto& option: m_options) {
+    invalidate_help();
+    for (std::size_t position = 0; position < m_options.size(); ++position) {
+        auto& option = m_options[position];
         option.set_appending(false);
+        const auto& state = m_result.state(position);
+        if (state.is_parsed() && (state.consumed == 0) && (state.values.size() != option.number_of_arguments())) {
+            std::string msg = "'" + std::string(option.get_name()) + "' expects " +
+                              std::to_string(option.number_of_arguments());
+            msg += " argument, but got " + std::to_string(state.values.size());
+            throw UsageException(msg);
+        }
     }
     for (auto& name : names) {
         auto& existing_option = find_option(name);
@@ -281,8 +1355,38 @@ void ap::add_xor(const ap::OptionNameSetType& names) {
     if (names.size() < 2) {
         throw UsageException("too less arguments for XOR");
     }
+    m_constraints.push_back({ConstraintType::exclusive, OptionMask::npos, to_mask(names)});
+}
+
+void ap::add_requires(const ap::OptionNameType& name, const ap::OptionNameSetType& required_names) {
+    if (required_names.empty()) {
+        throw UsageException("No option name was given");
+    }
+    const auto trigger = to_mask({name}).find({}, false);
+    m_constraints.push_back({ConstraintType::dependency, trigger, to_mask(required_names)});
+}
+
+void ap::add_at_least_one(const ap::OptionNameSetType& names) {
+    if (names.empty()) {
+        throw UsageException("No option name was given");
+    }
+    m_constraints.push_back({ConstraintType::at_least_one, OptionMask::npos, to_mask(names)});
+}
+
+void ap::add_inclusive(const ap::OptionNameSetType& names) {
+    if (names.size() < 2) {
+        throw UsageException("too less arguments for an inclusive group");
+    }
+    m_constraints.push_back({ConstraintType::inclusive, OptionMask::npos, to_mask(names)});
+}
+
+ap::OptionMask ap::to_mask(const ap::OptionNameSetType& names) const {
     ensure_valid_option_list(names);
-    m_xor_lists.emplace_back(names);
+    OptionMask mask;
+    for (const auto& name : names) {
+        mask.insert(find_option_position(name));
+    }
+    return mask;
 }
 
 void ap::ensure_valid_option_list(const ap::OptionNameSetType& names) const {
@@ -293,195 +1397,510 @@ void ap::ensure_valid_option_list(const ap::OptionNameSetType& names) const {
     }
 }
 
-std::vector<ap::Option, std::allocator<ap::Option>>::const_iterator
-ap::find_option_iter(const ap::OptionNameType& name) const {
-    auto iter = std::find_if(m_options.begin(), m_options.end(), [name](const Option& o) {
-        return o.has_name(name);
-    });
-    return iter;
+ap::OptionStorage::const_iterator
+ap::find_option_iter(std::string_view name) const {
+    const auto position = m_option_index.find(name);
+    return (position == OptionIndex::npos) ? m_options.end() : m_options.begin() + position;
 }
 
-ap::Option&
-ap::find_option_to_parse(const ap::OptionNameType& name) {
-    auto existing_option_iter = find_option_iter(normalize_option_name(name));
+std::size_t
+ap::find_option_to_parse(std::string_view name, utils::parse_error& error) const {
+    const auto normalized_name = normalize_option_name(name);
+    const auto position = m_option_index.find(normalized_name);
+    if (position != OptionIndex::npos) {
+        return position;
+    }
 
-    if (existing_option_iter == m_options.end()) {
-        throw ParsingException("Option '" + name + "' does not exist.");
-    } else {
-        return *existing_option_iter;
+    if (m_is_allowing_abbreviations && (normalized_name.size() > 1)) {  // a long name
+        const auto candidates = m_option_index.find_prefix(normalized_name);
+        if (candidates.first != candidates.second) {
+            const auto matched_position = candidates.first->second;
+            const bool is_unique = std::all_of(candidates.first, candidates.second, [&](const auto& candidate) {
+                return candidate.second == matched_position;  // several names of one option
+            });
+            if (is_unique) {
+                return matched_position;
+            }
+            error = parse_error::ambiguous_option;
+            return OptionIndex::npos;
+        }
+    }
+    error = parse_error::unknown_option;
+    return OptionIndex::npos;
+}
+
+std::size_t
+ap::find_option_position(std::string_view name) const {
+    const auto position = m_option_index.find(normalize_option_name(name));
+
+    if (position == OptionIndex::npos) {
+        throw ParsingException("Option '" + OptionNameType(name) + "' does not exist.");
     }
+    return position;
 }
 
 ap::Option&
-ap::find_option(const ap::OptionNameType& name) {
+ap::find_option(std::string_view name) {
     auto existing_option_iter = find_option_iter(normalize_option_name(name));
 
     if (existing_option_iter == m_options.end()) {
-        throw UsageException("Option '" + name + "' does not exist.");
+        throw UsageException("Option '" + OptionNameType(name) + "' does not exist.");
     } else {
         return *existing_option_iter;
     }
 }
 
 const ap::Option&
-ap::find_option(const ap::OptionNameType& name) const {
+ap::find_option(std::string_view name) const {
     auto existing_option_iter = find_option_iter(normalize_option_name(name));
 
     if (existing_option_iter == m_options.end()) {
-        throw ParsingException("Option '" + name + "' does not exist.");
+        throw ParsingException("Option '" + OptionNameType(name) + "' does not exist.");
     } else {
         return *existing_option_iter;
     }
 }
 
-bool ap::is_short_option_name(const ap::ArgumentType& arg) const {
+bool ap::is_short_option_name(ap::ArgumentViewType arg) const {
     return ((arg.size() > 1) && (arg[0] == '-') && std::isalpha(arg[1]));
 }
 
-bool ap::is_short_option_group_name(const ap::ArgumentType& arg) const {
+bool ap::is_short_option_group_name(ap::ArgumentViewType arg) const {
     return ((arg.size() > 2) && (arg[0] == '-') && std::isalpha(arg[1]) && std::isalpha(arg[2]));
 }
 
-bool ap::is_long_option(const ap::ArgumentType& arg) const {
+bool ap::is_long_option(ap::ArgumentViewType arg) const {
     return ((arg.size() > 3) && (arg[0] == '-') && (arg[1] == '-') && std::isalpha(arg[2]) &&
             (std::isalnum(arg[3]) || arg[3] == '-' || arg[3] == '_'));
 }
 
-ap::OptionNameType
-ap::strictly_normalize_option_name(const ap::OptionNameType& name) const {
-    if ((name.size() == 2) && (name[0] == '-')) { // short option
-        if (!std::isalpha(name[1])) {
-            throw UsageException("Illegal name, letter of  '" + name + "' is a non alpha-character");
-        }
-        return name.substr(1);
-    } else if ((name.size() >= 4) && (name[0] == '-') && (name[1] == '-')) { // long option
-        if (!std::isalpha(name[2])) {
-            throw UsageException("Illegal name, first letter of '" + name + "' is a non alpha-character");
-        }
-        for (const auto c : name) {
-            if ((!std::isalnum(c)) && c != '-' && c != '_') {
-                throw UsageException("'" + name + "' contains other characters than a-zA-Z0-9_-");
-            }
-        }
-        return name.substr(2);
-    } else {
-        throw UsageException("Given option name has to be '-[a-zA-Z0-9]' or '--[a-zA-Z0-9][a-zA-Z0-9_-]*'");
+std::string_view
+ap::strictly_normalize_option_name(std::string_view name) const {
+    const auto error = check_option_name(name);
+    if (error != option_name_error::none) {
+        throw_option_name_error(error, OptionNameType(name));
     }
+    return name.substr((name.size() == 2) ? 1 : 2);
 }
 
-ap::OptionNameType
-ap::normalize_option_name(const ap::OptionNameType& name) const {
+std::string_view
+ap::normalize_option_name(std::string_view name) const {
     if ((name.size() == 1) && name[0] != '-') { // short option
-        return strictly_normalize_option_name("-" + name);
-    } else if ((name.size() >= 2) && name[0] != '-') { // short option
-        return strictly_normalize_option_name("--" + name);
+        if (!is_option_alpha(name[0])) {
+            throw_option_name_error(option_name_error::short_not_alpha, "-" + OptionNameType(name));
+        }
+        return name;
+    } else if ((name.size() >= 2) && name[0] != '-') { // long option
+        const auto error = check_long_option_name(name);
+        if (error != option_name_error::none) {
+            throw_option_name_error(error, "--" + OptionNameType(name));
+        }
+        return name;
     } else {
         return strictly_normalize_option_name(name);
     }
 }
 
-std::pair<ap::OptionNameType, ap::StorageValueType>
-ap::split_argument_text(const ap::ArgumentType& text) const {
+std::pair<ap::ArgumentViewType, ap::ArgumentViewType>
+ap::split_argument_text(ap::ArgumentViewType text) const {
     if (is_short_option_name(text)) {
-        return {std::string(1, text[1]), text.substr(2)};
+        return {text.substr(1, 1), text.substr(2)};
     } else {
-        ArgumentType::size_type cur = 2;
-        while (std::isalnum(text[cur]) || text[cur] == '-' || text[cur] == '_') {
+        ArgumentViewType::size_type cur = 2;
+        while (cur < text.size() && (std::isalnum(text[cur]) || text[cur] == '-' || text[cur] == '_')) {
             cur++;
         }
         return {text.substr(2, cur - 2), text.substr(cur)};
     }
 }
 
-void ap::check_required_arguments() const {
-    std::string missing_requireds;
-    for (auto& option : m_options) {
-        if (option.is_required() && (!option.is_parsed())) {
-            missing_requireds += option.get_name() + ", ";
+void ap::check_required_arguments(const ap::Result& result, ap::ParseStatus& status) const {
+    ParseError error;
+    error.parser = this;
+    error.code = parse_error::missing_required;
+    const auto& parsed = result.m_parsed_options;
+    if (!m_required_options.is_subset_of(parsed)) {
+        for (auto position = m_required_options.find(parsed, false); position != OptionMask::npos;
+             position = m_required_options.find(parsed, false, position + 1)) {
+            error.option = m_options[position].get_name();
+            status.report(error);  // all of them, they are reported by one message
+        }
+        if (status.is_done()) {
+            return;
         }
     }
-    if (!missing_requireds.empty()) {
-        throw ParsingException("The following arguments are required, but were not set: " + missing_requireds);
-    }
-    if (m_positionals.size() < m_number_of_minimum_positionals) {
-        std::string error_msg = "There are " + std::to_string(m_number_of_minimum_positionals) +
-                                " positional arguments required, but only " + std::to_string(m_positionals.size()) +
-                                " were given.";
-        throw ParsingException(error_msg);
+    if (result.m_number_of_positionals < m_number_of_minimum_positionals) {
+        error.code = parse_error::too_few_positionals;
+        error.option = {};
+        error.expected = m_number_of_minimum_positionals;
+        error.given = result.m_number_of_positionals;
+        status.report(error);
     }
 }
 
-void ap::check_xor_arguments() const {
-    for (auto& xor_list: m_xor_lists) {
-        OptionNameType xor_option{};
-        for (auto& option: xor_list) {
-            if (is_parsed(option)) {
-                if (xor_option.empty()) {
-                    xor_option = option;
-                } else {
-                    std::string msg = "Option '" + xor_option + "' and '";
-                    msg += option + "' must not be used together.";
-                    throw ParsingException(msg);
+void ap::check_constraints(const ap::Result& result, ap::ParseStatus& status) const {
+    const auto& parsed = result.m_parsed_options;
+    for (std::size_t i = 0; (i < m_constraints.size()) && !status.is_done(); ++i) {
+        const auto& constraint = m_constraints[i];
+        const auto& options = constraint.options;
+        ParseError error;
+        switch (constraint.type) {
+            case ConstraintType::exclusive:
+                if (options.has_several_in(parsed)) {
+                    error.code = parse_error::mutually_exclusive;
+                    const auto first = options.find(parsed, true);
+                    error.option = m_options[first].get_name();
+                    error.detail = m_options[options.find(parsed, true, first + 1)].get_name();
+                }
+                break;
+            case ConstraintType::dependency:
+                if (((word_of(parsed, constraint.trigger / 64) >> (constraint.trigger % 64)) & 1) &&
+                    !options.is_subset_of(parsed)) {
+                    error.code = parse_error::missing_dependency;
+                    error.option = m_options[constraint.trigger].get_name();
+                    error.detail = m_options[options.find(parsed, false)].get_name();
                 }
+                break;
+            case ConstraintType::at_least_one:
+                if (!options.intersects(parsed)) {
+                    error.code = parse_error::missing_one_of;
+                    error.option = m_options[options.find({}, false)].get_name();
+                }
+                break;
+            case ConstraintType::inclusive:
+                if (options.intersects(parsed) && !options.is_subset_of(parsed)) {
+                    error.code = parse_error::incomplete_group;
+                    error.option = m_options[options.find(parsed, true)].get_name();
+                    error.detail = m_options[options.find(parsed, false)].get_name();
+                }
+                break;
+        }
+        if (error.code != parse_error::none) {
+            error.constraint = i;
+            error.parser = this;
+            status.report(error);
+        }
+    }
+}
+
+const std::size_t ap::OptionMask::npos;
+
+void ap::OptionMask::insert(std::size_t position) {
+    const auto index = position / 64;
+    const auto bit = std::uint64_t(1) << (position % 64);
+    auto word = std::lower_bound(m_words.begin(), m_words.end(), index,
+                                 [](const auto& entry, std::size_t value) { return entry.first < value; });
+    if ((word != m_words.end()) && (word->first == index)) {
+        word->second |= bit;
+    } else {
+        m_words.insert(word, {index, bit});
+    }
+}
+
+bool ap::OptionMask::intersects(const ap::OptionMask::BitSet& bits) const {
+    for (const auto& word : m_words) {
+        if ((word_of(bits, word.first) & word.second) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ap::OptionMask::is_subset_of(const ap::OptionMask::BitSet& bits) const {
+    for (const auto& word : m_words) {
+        if ((word_of(bits, word.first) & word.second) != word.second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ap::OptionMask::has_several_in(const ap::OptionMask::BitSet& bits) const {
+    bool has_one = false;
+    for (const auto& word : m_words) {
+        const auto common = word_of(bits, word.first) & word.second;
+        if (common != 0) {
+            if (has_one || ((common & (common - 1)) != 0)) {
+                return true;
             }
+            has_one = true;
         }
     }
+    return false;
 }
 
-std::vector<ap::Option, std::allocator<ap::Option>>::iterator
-ap::find_option_iter(const ap::OptionNameType& name) {
-    auto iter = std::find_if(m_options.begin(), m_options.end(), [name](const Option& o) {
-        return o.has_name(name);
-    });
-    return iter;
+std::size_t ap::OptionMask::find(const ap::OptionMask::BitSet& bits, bool is_contained, std::size_t start) const {
+    for (const auto& word : m_words) {
+        const auto first = word.first * 64;
+        if (first + 64 <= start) {
+            continue;
+        }
+        auto candidates = word.second & (is_contained ? word_of(bits, word.first) : ~word_of(bits, word.first));
+        if (start > first) {
+            candidates &= ~std::uint64_t(0) << (start - first);
+        }
+        if (candidates != 0) {
+            std::size_t bit = 0;
+            while (((candidates >> bit) & 1) == 0) {
+                ++bit;
+            }
+            return first + bit;
+        }
+    }
+    return npos;
+}
+
+ap::OptionStorage::iterator
+ap::find_option_iter(std::string_view name) {
+    const auto position = m_option_index.find(name);
+    return (position == OptionIndex::npos) ? m_options.end() : m_options.begin() + position;
 }
 
-ap::Option::Option(ap::ArgumentCountType number_of_arguments, ap::ChoiceStorageType choices)
-        : m_number_of_arguments(number_of_arguments), m_choices{std::move(choices)} {
+const std::size_t ap::OptionIndex::npos;
+
+ap::OptionIndex::OptionIndex() : m_long_slots(16, {std::string_view(), npos}) {
+    m_short_positions.fill(npos);
+}
+
+void ap::OptionIndex::insert(std::string_view name, std::size_t position) {
+    if (name.size() == 1) {
+        m_short_positions[short_slot(name[0])] = position;
+        return;
+    }
+    if (2 * (m_number_of_long_names + 1) > m_long_slots.size()) {
+        grow();
+    }
+    const auto mask = m_long_slots.size() - 1;
+    auto slot = std::hash<std::string_view>()(name) & mask;
+    while (m_long_slots[slot].second != npos && m_long_slots[slot].first != name) {
+        slot = (slot + 1) & mask;
+    }
+    if (m_long_slots[slot].second == npos) {
+        ++m_number_of_long_names;
+        m_long_slots[slot].first = name;
+        m_sorted_long_names.emplace_back(name, position);
+        m_is_sorted = false;
+    } else {
+        std::find_if(m_sorted_long_names.begin(), m_sorted_long_names.end(),
+                     [name](const auto& entry) { return entry.first == name; })
+                ->second = position;
+    }
+    m_long_slots[slot].second = position;
+}
+
+void ap::OptionIndex::sort_long_names() const {
+    if (m_is_sorted.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_sort_mutex);
+    if (!m_is_sorted.load(std::memory_order_relaxed)) {
+        std::sort(m_sorted_long_names.begin(), m_sorted_long_names.end(),
+                  [](const auto& entry, const auto& other) { return entry.first < other.first; });
+        m_is_sorted.store(true, std::memory_order_release);
+    }
+}
+
+void ap::OptionIndex::set_table(const utils::option_table_view& table) {
+    m_table = table;
+    for (std::size_t i = 0; i < table.number_of_specs; ++i) {
+        for (const auto& name : table.specs[i].names) {
+            if (name.size() > 2) {
+                m_sorted_long_names.emplace_back(name.substr(2), i);
+                m_is_sorted = false;
+            }
+        }
+    }
+}
+
+std::pair<ap::OptionIndex::SortedNameList::const_iterator, ap::OptionIndex::SortedNameList::const_iterator>
+ap::OptionIndex::find_prefix(std::string_view prefix) const {
+    sort_long_names();
+    const auto first = std::lower_bound(
+            m_sorted_long_names.begin(), m_sorted_long_names.end(), prefix,
+            [](const auto& entry, std::string_view other) { return entry.first < other; });
+    auto last = first;
+    while ((last != m_sorted_long_names.end()) && (last->first.compare(0, prefix.size(), prefix) == 0)) {
+        ++last;
+    }
+    return {first, last};
+}
+
+std::size_t ap::OptionIndex::find(std::string_view name) const {
+    if (m_table.number_of_specs != 0) {
+        const auto position = m_table.find(name);
+        if (position != m_table.number_of_specs) {
+            return position;
+        }
+    }
+    if (name.size() == 1) {
+        return std::isalpha(name[0]) ? m_short_positions[short_slot(name[0])] : npos;
+    }
+    const auto mask = m_long_slots.size() - 1;
+    for (auto slot = std::hash<std::string_view>()(name) & mask;
+         m_long_slots[slot].second != npos; slot = (slot + 1) & mask) {
+        if (m_long_slots[slot].first == name) {
+            return m_long_slots[slot].second;
+        }
+    }
+    return npos;
+}
+
+std::size_t ap::OptionIndex::short_slot(char letter) {
+    return (letter >= 'a' && letter <= 'z') ? static_cast<std::size_t>(letter - 'a')
+                                             : static_cast<std::size_t>(letter - 'A') + 26;
+}
+
+void ap::OptionIndex::grow() {
+    std::vector<std::pair<std::string_view, std::size_t>> slots(2 * m_long_slots.size(), {std::string_view(), npos});
+    const auto mask = slots.size() - 1;
+    for (auto& entry : m_long_slots) {
+        if (entry.second == npos) {
+            continue;
+        }
+        auto slot = std::hash<std::string_view>()(entry.first) & mask;
+        while (slots[slot].second != npos) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = std::move(entry);
+    }
+    m_long_slots.swap(slots);
+}
+
+const std::size_t ap::ChoiceSet::npos;
+
+ap::ChoiceSet::ChoiceSet(std::vector<ap::StorageValueType> choices) : m_choices(std::move(choices)) {
+    std::size_t number_of_slots = 4;
+    while (number_of_slots < 2 * m_choices.size()) {
+        number_of_slots *= 2;
+    }
+    m_slots.assign(number_of_slots, npos);
+    const auto mask = number_of_slots - 1;
+    for (std::size_t i = 0; i < m_choices.size(); ++i) {
+        auto slot = std::hash<std::string_view>()(m_choices[i]) & mask;
+        while (m_slots[slot] != npos) {
+            if (m_choices[m_slots[slot]] == m_choices[i]) {
+                throw UsageException("Choice '" + m_choices[i] + "' is given twice");
+            }
+            slot = (slot + 1) & mask;
+        }
+        m_slots[slot] = i;
+    }
+}
+
+std::size_t ap::ChoiceSet::find(ap::ArgumentViewType value) const {
+    const auto mask = m_slots.size() - 1;
+    for (auto slot = std::hash<std::string_view>()(value) & mask; m_slots[slot] != npos; slot = (slot + 1) & mask) {
+        if (m_choices[m_slots[slot]] == value) {
+            return m_slots[slot];
+        }
+    }
+    return npos;
+}
+
+ap::Option::Option(ap::ArgumentCountType number_of_arguments, const ap::ChoiceStorageType& choices)
+        : Option(number_of_arguments, std::vector<ChoiceSet>()) {
+    if ((!choices.empty()) && (m_number_of_arguments != choices.size())) {
+        throw UsageException("Number of arguments does not match number of choices");
+    }
+    m_choices.reserve(choices.size());
+    for (const auto& argument_choices : choices) {
+        m_choices.emplace_back(std::vector<StorageValueType>(argument_choices.begin(), argument_choices.end()));
+    }
+    m_has_ordered_choices = m_choices.empty();
+}
+
+ap::Option::Option(ap::ArgumentCountType number_of_arguments, std::vector<ap::ChoiceSet> choices)
+        : m_choices{std::move(choices)}, m_number_of_arguments(number_of_arguments), m_is_appending(false),
+          m_is_hidden(false), m_is_required(false), m_has_ordered_choices(true) {
     if ((!m_choices.empty()) && (m_number_of_arguments != m_choices.size())) {
         throw UsageException("Number of arguments does not match number of choices");
     }
     if (number_of_arguments == 0) { m_default_storage = {"false"}; }  // special handling for flags
 }
 
-void ap::Option::parse(const ap::StorageType& values) {
+bool ap::Option::parse(const ap::ArgumentViewListType& values, ap::OptionState& state, ap::ParseError& error) const {
+    error.option = get_name();
     if (values.size() != m_number_of_arguments) {
-        std::string msg = "Option '" + get_name() + "' expects " + std::to_string(m_number_of_arguments);
-        msg += " argument, but " + std::to_string(values.size()) + " were given.";
-        throw ParsingException(msg);
+        error.code = parse_error::wrong_number_of_arguments;
+        error.expected = m_number_of_arguments;
+        error.given = values.size();
+        return false;
     }
-    if (!m_storage.empty() && !m_is_appending) {
-        throw ParsingException("Option '" + get_name() + "' already parsed");
+    if (state.is_parsed() && !m_is_appending) {
+        error.code = parse_error::repeated_option;
+        return false;
     }
+    if (m_callback) {  // the values go to the callback instead of the state, validated as they would be stored
+        for (StorageType::size_type i = 0; i < m_choices.size(); ++i) {
+            if (m_choices[i].find(values[i]) == ChoiceSet::npos) {
+                error.code = parse_error::invalid_choice;
+                error.argument = values[i];
+                return false;
+            }
+        }
+        for (const auto& value : values) {
+            TypedValue typed{};
+            if ((m_convert != nullptr) && !m_convert(value, typed)) {
+                error.code = parse_error::invalid_value;
+                error.argument = value;
+                return false;
+            }
+        }
+        for (const auto& value : values) {
+            if (!m_callback(value)) {
+                error.code = parse_error::invalid_value;
+                error.argument = value;
+                return false;
+            }
+        }
+        if ((m_number_of_arguments == 0) && !m_callback("true")) {
+            error.code = parse_error::invalid_value;
+            error.argument = "true";
+            return false;
+        }
+        state.consumed += std::max<std::size_t>(values.size(), 1);
+        return true;
+    }
+
+    auto& storage = state.values;
+    const auto previous_size = storage.size();
+    auto fail = [&](parse_error code, ArgumentViewType value) {
+        storage.resize(previous_size);
+        state.typed_values.resize(std::min(state.typed_values.size(), previous_size));
+        state.choice_indices.resize(std::min(state.choice_indices.size(), previous_size));
+        error.code = code;
+        error.argument = value;
+        return false;
+    };
+
     if (m_number_of_arguments == 0) {  // special handling for flags
-        m_storage.emplace_back("true");
+        storage.emplace_back("true");
     } else {
         if (!m_choices.empty()) {  // special options with values for flags
             for (StorageType::size_type i = 0; i < m_number_of_arguments; ++i) {
-                if (std::find(m_choices[i].begin(), m_choices[i].end(), values[i]) != m_choices[i].end()) {
-                    m_storage.emplace_back(values[i]);
-                } else {
-                    std::string msg = "'" + values[i] + "' does not match possible choices for " + get_name();
-                    throw ParsingException(msg);
+                const auto choice_index = m_choices[i].find(values[i]);
+                if (choice_index == ChoiceSet::npos) {
+                    return fail(parse_error::invalid_choice, values[i]);
                 }
+                storage.emplace_back(values[i]);
+                state.choice_indices.push_back(choice_index);
             }
         } else {
             for (auto& value : values) {
-                m_storage.emplace_back(value);
+                storage.emplace_back(value);
             }
         }
     }
-}
-
-void ap::Option::set_appending(bool is_appending) {
-    m_is_appending = is_appending;
-    if ((!is_appending) && (!m_storage.empty()) && (m_storage.size() != m_number_of_arguments)) {
-        if (m_storage.size() != m_number_of_arguments) {
-            std::string msg = "'" + get_name() + "' expects " + std::to_string(m_number_of_arguments);
-            msg += " argument, but got " + std::to_string(m_storage.size());
-            throw UsageException(msg);
+    if (m_convert != nullptr) {
+        for (auto i = previous_size; i < storage.size(); ++i) {
+            TypedValue typed{};
+            if (!m_convert(storage[i], typed)) {
+                return fail(parse_error::invalid_value, storage[i]);
+            }
+            state.typed_values.push_back(typed);
         }
     }
+    return true;
 }
 
 void ap::Option::set_default(const ap::StorageType& values) {
@@ -490,12 +1909,14 @@ void ap::Option::set_default(const ap::StorageType& values) {
     }
     if (m_number_of_arguments != 0) { //  ignore for option flags
         m_default_storage.clear();
+        m_default_choice_indices.clear();
 
         if ((!values.empty()) && (!m_choices.empty())) {  // special options with values for flags
             for (StorageType::size_type i = 0; i < m_number_of_arguments; ++i) {
-                if (std::find(m_choices[i].begin(), m_choices[i].end(), values[i]) !=
-                    m_choices[i].end()) {
+                const auto choice_index = m_choices[i].find(values[i]);
+                if (choice_index != ChoiceSet::npos) {
                     m_default_storage.emplace_back(values[i]);
+                    m_default_choice_indices.push_back(choice_index);
                 } else {
                     throw UsageException("Value does not match any possible choice");
                 }
@@ -503,98 +1924,128 @@ void ap::Option::set_default(const ap::StorageType& values) {
         } else {
             m_default_storage = values;
         }
+        convert_defaults();
     }
 }
 
-void ap::Option::set_meta_vars(const ap::MetaVarListType& meta_vars) {
-    if ((!meta_vars.empty()) && (meta_vars.size() != m_number_of_arguments)) {
-        throw UsageException("number of meta vars does not match number of arguments");
+void ap::Option::convert_defaults() {
+    m_typed_default_storage.clear();
+    if (m_convert == nullptr) {
+        return;
+    }
+    for (const auto& value : m_default_storage) {
+        TypedValue typed{};
+        if (!m_convert(value, typed)) {
+            throw UsageException("Default value '" + value + "' does not match the type of the option");
+        }
+        m_typed_default_storage.push_back(typed);
     }
-    m_meta_vars = meta_vars;
 }
 
-void ap::Option::set_names(const ap::OptionNameSetType& names) {
-    if (names.empty()) {
-        throw UsageException("No name given for option.");
+bool ap::Option::apply_defaults(ap::ParseError& error) const {
+    for (const auto& value : m_default_storage) {
+        if (!m_callback(value)) {
+            error.code = parse_error::invalid_value;
+            error.option = get_name();
+            error.argument = value;
+            return false;
+        }
     }
-    m_names = names;
+    return true;
 }
 
-bool ap::Option::has_name(const ap::OptionNameType& name) const {
-    return m_names.find(name) != m_names.end();
+void ap::Option::ensure_stored(const ap::OptionState& state) const {
+    if (state.consumed != 0) {
+        throw UsageException("Option '" + std::string(get_name()) +
+                             "' hands its values to a callback, they are not stored");
+    }
 }
 
-std::string ap::Option::get_name() const { return m_names.empty() ? "" : *m_names.begin(); }
+ap::StorageType::size_type ap::Option::active_size(const ap::OptionState& state) const {
+    ensure_stored(state);
+    if (state.is_parsed()) {
+        return state.values.size();
+    } else if (has_default()) {
+        return m_default_storage.size();
+    }
+    throw ParsingException("Failed to get unparsed error");
+}
 
-std::pair<std::string, std::string> ap::Option::generate_help_text() const {
-    std::string name_text;
-    for (const auto& name : m_names) {
-        if (name.size() == 1) {
-            name_text += " -" + name;
-        } else {
-            name_text += " --" + name;
-        }
+std::size_t ap::Option::choice_index(const ap::OptionState& state, ap::StorageType::size_type index) const {
+    if (m_choices.empty()) {
+        throw UsageException("Option '" + std::string(get_name()) + "' has no choices");
+    }
+    ensure_stored(state);
+    if (state.is_parsed()) {
+        return state.choice_indices[index];
+    } else if (has_default()) {
+        return m_default_choice_indices[index];
     }
+    throw ParsingException("Failed to get unparsed error");
+}
 
-    if (!m_meta_vars.empty()) {
-        for (auto& meta_var : m_meta_vars) {
-            name_text += " <" + meta_var + ">";
-        }
-    } else {
-        for (ArgumentCountType i = 0; i < m_number_of_arguments; ++i) {
-            name_text += " <ARG>";
-        }
+ap::ArgumentViewType ap::Option::active_text(const ap::OptionState& state,
+                                             ap::StorageType::size_type index) const {
+    ensure_stored(state);
+    if (state.is_parsed()) {
+        return state.values[index];
+    } else if (has_default()) {
+        return m_default_storage[index];
     }
+    throw ParsingException("Failed to get unparsed error");
+}
 
-    std::string help_text;
-    // add required
+void ap::Option::append_help_properties(std::string& text, std::string_view environment_variable) const {
+    const auto start = text.size();
+    // opens the list of properties or separates them
+    auto separate = [&]() { text += (text.size() == start) ? " (" : ", "; };
     if (is_required()) {
-        help_text += "required";
+        separate();
+        text += "required";
     }
-    // add required
     if (is_appending()) {
-        if (!help_text.empty()) {
-            help_text += ", ";
-        }
-        help_text += "appending";
+        separate();
+        text += "appending";
     }
-    // add choices
     if ((m_number_of_arguments > 0) && (!m_choices.empty())) {
-        if (!help_text.empty()) {
-            help_text += ", ";
-        }
-        help_text += "choices:";
-        for (auto& argument_choices : m_choices) {
-            help_text += " [";
-            for (auto& choice : argument_choices) {
-                help_text += choice + "|";
+        separate();
+        text += "choices:";
+        for (const auto& argument_choices : m_choices) {
+            text += " [";
+            for (std::size_t i = 0; i < argument_choices.choices().size(); ++i) {
+                if (i != 0) {
+                    text += '|';
+                }
+                text += argument_choices.choices()[i];
             }
-            help_text.erase(help_text.end() - 1, help_text.end());  // remove last whitespace
-            help_text += "]";
+            text += ']';
         }
     }
-
-    // add default
     if ((m_number_of_arguments > 0) && (!m_default_storage.empty())) {
-        if (!help_text.empty()) {
-            help_text += ", ";
-        }
-        help_text += "default: ";
-        for (auto& default_value : m_default_storage) {
-            help_text += default_value + " ";
+        separate();
+        text += "default:";
+        for (const auto& default_value : m_default_storage) {
+            text += ' ';
+            text += default_value;
         }
-        help_text.erase(help_text.end() - 1, help_text.end());  // remove last whitespace
     }
-
-    if (!help_text.empty()) {
-        help_text = " (" + help_text + ")";
+    if (!environment_variable.empty()) {
+        separate();
+        text += "env: ";
+        text += environment_variable;
+    }
+    if (text.size() != start) {
+        text += ')';
     }
-    help_text = m_help + help_text;
+}
 
-    return {name_text, help_text};
+void ap::Option::parse_value(ap::ArgumentViewType text, bool& value) {
+    if (!try_parse_value(text, value)) {
+        throw ParsingException("Argument ‘" + StorageValueType(text) + "’ failed to parse");
+    }
 }
 
-void ap::Option::parse_value(const ap::StorageValueType& text, bool& value) {
+bool ap::Option::try_parse_value(ap::ArgumentViewType text, bool& value) {
     StorageValueType lower_text(text);
     std::transform(lower_text.begin(), lower_text.end(), lower_text.begin(), ::tolower);
 
@@ -609,11 +2060,205 @@ void ap::Option::parse_value(const ap::StorageValueType& text, bool& value) {
                (lower_text == "no")) {
         value = false;
     } else {
-        throw ParsingException("Argument ‘" + text + "’ failed to parse");
+        return false;
     }
+    return true;
 }
 
 void
-ap::Option::parse_value(const ap::StorageValueType& text, std::string& value) {
-    value = text;
+ap::Option::parse_value(ap::ArgumentViewType text, std::string& value) {
+    value.assign(text);
+}
+
+bool ap::Option::try_parse_value(ap::ArgumentViewType text, std::string& value) {
+    value.assign(text);
+    return true;
+}
+
+bool ap::Result::is_parsed(const ap::OptionNameType& name) const {
+    return parser().is_parsed(*this, name);
+}
+
+std::size_t ap::Result::get_choice_index(const ap::OptionNameType& name) const {
+    return parser().get_choice_index(*this, name);
+}
+
+std::vector<std::size_t> ap::Result::get_choice_indices(const ap::OptionNameType& name) const {
+    return parser().get_choice_indices(*this, name);
+}
+
+const ap::Result& ap::Result::get_subcommand_result() const {
+    if (m_subcommand.empty() || !m_subcommand_result) {
+        throw UsageException("No subcommand was parsed");
+    }
+    return *m_subcommand_result;
+}
+
+const ap::StorageType& ap::Result::get_positionals() const {
+    if (m_positional_copies.size() != m_positionals.size()) {
+        m_positional_copies.assign(m_positionals.begin(), m_positionals.end());
+    }
+    return m_positional_copies;
+}
+
+void ap::Result::clear() {
+    for (auto& state : m_options) {
+        state.values.clear();
+        state.consumed = 0;
+        state.typed_values.clear();
+        state.choice_indices.clear();
+    }
+    std::fill(m_parsed_options.begin(), m_parsed_options.end(), 0);
+    m_positionals.clear();
+    m_number_of_positionals = 0;
+    m_positional_copies.clear();
+    m_copied_arguments.clear();
+    m_values.clear();
+    m_arena.clear();
+    m_response_files.clear();
+    m_program_name = {};
+    m_subcommand = {};
+    if (m_subcommand_result) {
+        m_subcommand_result->clear();
+    }
+}
+
+const ap& ap::Result::parser() const {
+    if (m_parser == nullptr) {
+        throw UsageException("Result was not filled by a parser.");
+    }
+    return *m_parser;
+}
+
+const ap::OptionState& ap::Result::state(std::size_t position) const {
+    static const OptionState unparsed{};
+    return (position < m_options.size()) ? m_options[position] : unparsed;
+}
+
+const std::size_t ap::ParseError::npos;
+
+std::string ap::ParseError::message() const {
+    const auto argument_text = ArgumentType(argument);
+    const auto option_name = OptionNameType(option);
+    std::string msg;
+    switch (code) {
+        case parse_error::none:
+            break;
+        case parse_error::no_arguments:
+            msg = "argument parser was called with zero arguments.";
+            break;
+        case parse_error::unreadable_response_file:
+            msg = "Response file '" + argument_text + "' could not be read";
+            break;
+        case parse_error::nested_response_file:
+            msg = "Response file '" + argument_text + "' is nested deeper than " + std::to_string(expected) +
+                  " levels";
+            break;
+        case parse_error::missing_quote:
+            msg = "Missing closing quote " + ArgumentType(detail) + " in '" + argument_text + "'";
+            break;
+        case parse_error::unknown_subcommand:
+            msg = "Unknown subcommand '" + argument_text + "'";
+            break;
+        case parse_error::unknown_option:
+            msg = "Option '" + option_name + "' does not exist.";
+            break;
+        case parse_error::ambiguous_option: {
+            msg = "Option '--" + option_name + "' is ambiguous, it could be";
+            const auto candidates = parser->m_option_index.find_prefix(option);
+            for (auto iter = candidates.first; iter != candidates.second; ++iter) {
+                msg += (iter == candidates.first ? " --" : ", --") + OptionNameType(iter->first);
+            }
+            break;
+        }
+        case parse_error::invalid_option_group:
+            msg = "only alpha chars are allowed for option sequences, not: " + argument_text;
+            break;
+        case parse_error::option_after_positional:
+            msg = "Found an option after a positional was given '" + argument_text + "'";
+            break;
+        case parse_error::too_many_positionals:
+            msg = "Found an additional positional argument '" + argument_text +
+                  "', although maximum number of positional arguments is already reached.";
+            break;
+        case parse_error::unrecognized_argument:
+            msg = "Unrecognized argument found: " + argument_text;
+            break;
+        case parse_error::wrong_number_of_arguments:
+            msg = "Option '" + option_name + "' expects " + std::to_string(expected) + " argument, but " +
+                  std::to_string(given) + " were given.";
+            break;
+        case parse_error::repeated_option:
+            msg = "Option '" + option_name + "' already parsed";
+            break;
+        case parse_error::invalid_choice:
+            msg = "'" + argument_text + "' does not match possible choices for " + option_name;
+            break;
+        case parse_error::invalid_value:
+            msg = "Argument ‘" + argument_text + "’ failed to parse";
+            break;
+        case parse_error::missing_required:
+            msg = "The following arguments are required, but were not set: " + option_name + ", ";
+            break;
+        case parse_error::too_few_positionals:
+            msg = "There are " + std::to_string(expected) + " positional arguments required, but only " +
+                  std::to_string(given) + " were given.";
+            break;
+        case parse_error::mutually_exclusive:
+            msg = "Option '" + option_name + "' and '" + ArgumentType(detail) + "' must not be used together.";
+            break;
+        case parse_error::missing_dependency:
+            msg = "Option '" + option_name + "' requires '" + ArgumentType(detail) + "'.";
+            break;
+        case parse_error::missing_one_of: {
+            msg = "At least one of the options ";
+            const auto& options = parser->m_constraints[constraint].options;
+            for (auto position = options.find({}, false); position != OptionMask::npos;
+                 position = options.find({}, false, position + 1)) {
+                msg += "'";
+                msg += parser->m_options[position].get_name();
+                msg += "', ";
+            }
+            msg.resize(msg.size() - 2);
+            msg += " is required.";
+            break;
+        }
+        case parse_error::incomplete_group:
+            msg = "Option '" + option_name + "' has to be used together with '" + ArgumentType(detail) + "'.";
+            break;
+    }
+    if (!variable.empty()) {
+        msg = "Environment variable '" + ArgumentType(variable) + "': " + msg;
+    }
+    return msg;
+}
+
+utils::parse_error ap::ParseStatus::code() const {
+    return m_errors.empty() ? parse_error::none : m_errors.front().code;
+}
+
+std::size_t ap::ParseStatus::argument_index() const {
+    return m_errors.empty() ? ParseError::npos : m_errors.front().argument_index;
+}
+
+ap::ArgumentViewType ap::ParseStatus::option() const {
+    return m_errors.empty() ? ArgumentViewType() : m_errors.front().option;
+}
+
+std::string ap::ParseStatus::message() const {
+    if (m_errors.empty()) {
+        return {};
+    }
+    auto msg = m_errors.front().message();
+    if (m_errors.front().code == parse_error::missing_required) {
+        for (std::size_t i = 1; (i < m_errors.size()) && (m_errors[i].code == parse_error::missing_required); ++i) {
+            msg += OptionNameType(m_errors[i].option) + ", ";
+        }
+    }
+    return msg;
+}
+
+void ap::ParseStatus::report(ap::ParseError error, bool is_fatal) {
+    m_errors.push_back(error);
+    m_is_stopped = m_is_stopped || is_fatal;
 }
@@ -10,11 +10,21 @@
  */
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 #include <sstream>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <type_traits>
 
 namespace utils {
 class UsageException : public std::runtime_error {
@@ -27,15 +37,208 @@ public:
     explicit ParsingException(const std::string& msg) noexcept : std::runtime_error(msg) {}
 };
 
+// Naming rules of option names, shared by the runtime parser and the compile time tables.
+enum class option_name_error { none, short_not_alpha, long_not_alpha, long_illegal_character, malformed };
+
+// Problems found while parsing, reported by argument_parser::try_parse().
+enum class parse_error {
+    none,
+    no_arguments,
+    unreadable_response_file,
+    nested_response_file,
+    missing_quote,
+    unknown_subcommand,
+    unknown_option,
+    ambiguous_option,
+    invalid_option_group,
+    option_after_positional,
+    too_many_positionals,
+    unrecognized_argument,
+    wrong_number_of_arguments,
+    repeated_option,
+    invalid_choice,
+    invalid_value,
+    missing_required,
+    too_few_positionals,
+    mutually_exclusive,
+    missing_dependency,
+    missing_one_of,
+    incomplete_group
+};
+
+constexpr bool is_option_alpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr bool is_option_character(char c) {
+    return is_option_alpha(c) || (c >= '0' && c <= '9') || c == '-' || c == '_';
+}
+
+// checks a long name without its leading dashes
+constexpr option_name_error check_long_option_name(std::string_view name) {
+    if (name.size() < 2) {
+        return option_name_error::malformed;
+    } else if (!is_option_alpha(name[0])) {
+        return option_name_error::long_not_alpha;
+    }
+    for (std::size_t i = 0; i < name.size(); ++i) {
+        if (!is_option_character(name[i])) {
+            return option_name_error::long_illegal_character;
+        }
+    }
+    return option_name_error::none;
+}
+
+// checks a name given with its leading dashes, like `-v` or `--verbose`
+constexpr option_name_error check_option_name(std::string_view name) {
+    if ((name.size() == 2) && (name[0] == '-')) {
+        return is_option_alpha(name[1]) ? option_name_error::none : option_name_error::short_not_alpha;
+    } else if ((name.size() >= 4) && (name[0] == '-') && (name[1] == '-')) {
+        return check_long_option_name(name.substr(2));
+    }
+    return option_name_error::malformed;
+}
+
+// FNV-1a over a name without dashes, `seed` selects the hash function of a perfect hash
+constexpr std::uint64_t option_name_hash(std::string_view name, std::uint64_t seed) {
+    std::uint64_t hash = 14695981039346656037ull ^ seed;
+    for (std::size_t i = 0; i < name.size(); ++i) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash ^ (hash >> 29);
+}
+
+// An option declared at compile time. Names include their dashes, unused names are empty.
+struct option_spec {
+    static constexpr std::size_t max_names{4};
+
+    std::array<std::string_view, max_names> names;
+    unsigned int number_of_arguments{1};
+    std::string_view help{};
+    std::string_view meta_var{};  // used for every argument of the option
+    std::string_view default_value{};  // only for options with one argument
+};
+
+// Type independent view on an option_table, which has to outlive the parsers using it.
+struct option_table_view {
+    const option_spec* specs;
+    std::size_t number_of_specs;
+    const std::string_view* slot_names;
+    const std::size_t* slot_positions;
+    std::size_t slot_mask;
+    std::uint64_t seed;
+
+    // position of the spec with the given name without dashes, number_of_specs if unknown
+    constexpr std::size_t find(std::string_view name) const {
+        const auto slot = option_name_hash(name, seed) & slot_mask;
+        return (slot_names[slot] == name) ? slot_positions[slot] : number_of_specs;
+    }
+};
+
+// Option specs validated at compile time and indexed by a perfect hash over all names,
+// build it with make_option_table() into a constexpr variable.
+template<std::size_t N>
+class option_table {
+public:
+    static constexpr std::size_t slot_count() {
+        std::size_t count = 2;
+        while (count < 2 * N * option_spec::max_names) {
+            count *= 2;
+        }
+        return count;
+    }
+
+    constexpr explicit option_table(const option_spec (&specs)[N]) : m_specs{}, m_slot_names{}, m_slot_positions{} {
+        std::size_t number_of_names = 0;
+        for (std::size_t i = 0; i < N; ++i) {
+            m_specs[i] = specs[i];
+            bool has_name = false;
+            // names are only referenced, GCC 12 rejects copies of unset names in constant expressions
+            for (std::size_t j = 0; j < option_spec::max_names; ++j) {
+                const auto& name = specs[i].names[j];
+                if (name.empty()) {
+                    continue;
+                }
+                if (check_option_name(name) != option_name_error::none) {
+                    throw UsageException("Given option name has to be '-[a-zA-Z]' or '--[a-zA-Z][a-zA-Z0-9_-]*'");
+                }
+                has_name = true;
+                ++number_of_names;
+            }
+            if (!has_name) {
+                throw UsageException("No option name was given");
+            }
+            if (!specs[i].default_value.empty() && specs[i].number_of_arguments != 1) {
+                throw UsageException("number of default arguments does not match number of arguments");
+            }
+        }
+        // try seeds until no two names share a slot, the table is at most half full
+        for (m_seed = 0;; ++m_seed) {
+            if (try_seed()) {
+                return;
+            }
+        }
+    }
+
+    constexpr option_table_view view() const {
+        return {m_specs.data(), N, m_slot_names.data(), m_slot_positions.data(), slot_count() - 1, m_seed};
+    }
+
+    constexpr std::size_t find(std::string_view name) const { return view().find(name); }
+
+private:
+    static constexpr std::string_view strip_dashes(std::string_view name) {
+        return name.substr(name.size() == 2 ? 1 : 2);
+    }
+
+    constexpr bool try_seed() {
+        for (std::size_t slot = 0; slot < slot_count(); ++slot) {
+            m_slot_names[slot] = std::string_view();
+        }
+        for (std::size_t i = 0; i < N; ++i) {
+            for (std::size_t j = 0; j < option_spec::max_names; ++j) {
+                const auto& name = m_specs[i].names[j];
+                if (name.empty()) {
+                    continue;
+                }
+                const auto key = strip_dashes(name);
+                const auto slot = option_name_hash(key, m_seed) & (slot_count() - 1);
+                if (m_slot_names[slot] == key) {
+                    throw UsageException("Option '" + std::string(name) + "' already exists");
+                } else if (!m_slot_names[slot].empty()) {
+                    return false;
+                }
+                m_slot_names[slot] = key;
+                m_slot_positions[slot] = i;
+            }
+        }
+        return true;
+    }
+
+    std::array<option_spec, N> m_specs;
+    std::array<std::string_view, slot_count()> m_slot_names;
+    std::array<std::size_t, slot_count()> m_slot_positions;
+    std::uint64_t m_seed{0};
+};
+
+template<std::size_t N>
+constexpr option_table<N> make_option_table(const option_spec (&specs)[N]) {
+    return option_table<N>(specs);
+}
+
 class argument_parser {
 public:
     using ArgumentType = std::string;
     using ArgumentListType = std::vector<ArgumentType>;
+    using ArgumentViewType = std::string_view;
+    using ArgumentViewListType = std::vector<ArgumentViewType>;
     using OptionNameType = ArgumentType;
     using OptionNameSetType = std::unordered_set<OptionNameType>;
     using StorageValueType = ArgumentType;
     using StorageType = std::vector<StorageValueType>;
     using ChoiceStorageType = std::vector<std::unordered_set<StorageValueType>>;
+    using OrderedChoiceStorageType = std::vector<std::vector<StorageValueType>>;
     using HelpTextType = std::string;
     using MetaVarListType = std::vector<HelpTextType>;
     using ArgumentCountType = unsigned int;
@@ -43,6 +246,11 @@ public:
 
     argument_parser() = default;
 
+    // Adds the options of a compile time table, whose names were validated and hashed by the
+    // compiler. Their names and help texts refer to the table. Further options may be added as
+    // usual.
+    explicit argument_parser(const option_table_view& table);
+
     argument_parser(const argument_parser&) = delete;
 
     ~argument_parser() = default;
@@ -77,34 +285,184 @@ public:
                     const StorageType& default_values = {},
                     const ChoiceStorageType& choices = {});
 
+    // The choices are numbered in the given order, see get_choice_index(). A template only so
+    // that braced lists keep selecting the overload above.
+    template<typename Choices,
+             typename = std::enable_if_t<std::is_same<Choices, OrderedChoiceStorageType>::value>>
+    void add_option(const OptionNameSetType& names, ArgumentCountType number_of_arguments,
+                    const HelpTextType& help, const std::vector<HelpTextType>& meta_vars,
+                    const StorageType& default_values, const Choices& choices) {
+        std::vector<ChoiceSet> choice_sets;
+        choice_sets.reserve(choices.size());
+        for (const auto& argument_choices : choices) {
+            choice_sets.emplace_back(argument_choices);
+        }
+        insert_option(names, Option(number_of_arguments, std::move(choice_sets)), help, meta_vars, default_values);
+    }
+
+    // Options declared with a value type are converted and validated once in parse(), which
+    // throws a ParsingException for malformed values. get<T>() with the declared type is a
+    // plain read, other types are still converted from the argument text.
+    template<typename T>
+    void add_option(const OptionNameSetType& names,
+                    const HelpTextType& help = "") {
+        add_option<T>(names, 1, help, {}, {});
+    }
+
+    template<typename T>
+    void add_option(const OptionNameSetType& names,
+                    const HelpTextType& help, const HelpTextType& meta_var) {
+        add_option<T>(names, 1, help, {meta_var}, {});
+    }
+
+    template<typename T>
+    void add_option(const OptionNameSetType& names,
+                    const HelpTextType& help, const HelpTextType& meta_var,
+                    const StorageValueType& default_value) {
+        add_option<T>(names, 1, help, {meta_var}, {default_value});
+    }
+
+    template<typename T>
+    void add_option(const OptionNameSetType& names, ArgumentCountType number_of_arguments,
+                    const HelpTextType& help = "",
+                    const std::vector<HelpTextType>& meta_vars = {},
+                    const StorageType& default_values = {},
+                    const ChoiceStorageType& choices = {}) {
+        auto option = Option(number_of_arguments, choices);
+        option.set_value_type<T>();
+        insert_option(names, std::move(option), help, meta_vars, default_values);
+    }
+
+    // An option with one argument whose choices map to values of `Enum`, read them with
+    // get<Enum>(). The choices are numbered in the given order, see get_choice_index().
+    template<typename Enum>
+    void add_enum_option(const OptionNameSetType& names,
+                         const std::vector<std::pair<StorageValueType, Enum>>& choices,
+                         const HelpTextType& help = "", const HelpTextType& meta_var = "",
+                         const StorageValueType& default_value = "") {
+        static_assert(std::is_enum<Enum>::value, "Use an enum type for enum options");
+
+        std::vector<StorageValueType> choice_names;
+        std::vector<long long> choice_values;
+        for (const auto& choice : choices) {
+            choice_names.push_back(choice.first);
+            choice_values.push_back(static_cast<long long>(choice.second));
+        }
+        auto option = Option(1, {ChoiceSet(std::move(choice_names))});
+        option.set_enum_values<Enum>(std::move(choice_values));
+        insert_option(names, std::move(option), help, meta_var.empty() ? MetaVarListType() : MetaVarListType{meta_var},
+                      default_value.empty() ? StorageType() : StorageType{default_value});
+    }
+
     bool has_option(const OptionNameType& name) const;
 
+    // The same for all names of an option, i.e. the order in which the options were added.
+    // Like the queries below it throws a ParsingException for unknown names.
+    std::size_t find_option_position(std::string_view name) const;
+
+    ArgumentCountType number_of_arguments(const OptionNameType& name) const;
+
+    bool has_default(const OptionNameType& name) const;
+
+    // true if the values go to a callback or bound variable, get() can not read them then
+    bool has_callback(const OptionNameType& name) const;
+
+    using ValueCallback = std::function<bool(ArgumentViewType value)>;
+
+    // Hands every value of the option to `callback` while parsing instead of storing it, the
+    // callback refuses malformed values by returning false. Flags pass "true", options that
+    // were not given pass their default values at the end of parse(). Values handed over
+    // before a refused one are not taken back, and get() can not read the option anymore.
+    // Callbacks run on the threads calling parse().
+    void set_callback(const OptionNameType& name, ValueCallback callback);
+
+    // Converts the value of the option into `variable` while parsing, like get<T>() would.
+    template<typename T>
+    void bind(const OptionNameType& name, T& variable) {
+        static_assert(std::is_fundamental<T>::value ||
+                      std::is_same<T, std::string>::value, "Use fundamental type to bind an option");
+        set_callback(name, [&variable](ArgumentViewType text) { return Option::try_parse_value(text, variable); });
+    }
+
+    // appends every value, e.g. of appending options or options with several arguments
+    template<typename T>
+    void bind(const OptionNameType& name, std::vector<T>& container) {
+        static_assert(std::is_fundamental<T>::value ||
+                      std::is_same<T, std::string>::value, "Use fundamental type to bind an option");
+        set_callback(name, [&container](ArgumentViewType text) {
+            T value;
+            if (!Option::try_parse_value(text, value)) {
+                return false;
+            }
+            container.push_back(std::move(value));
+            return true;
+        });
+    }
+
+    class Result;
+
+    struct ParseError;
+
+    class ParseStatus;
+
+    // Values and positionals refer to the memory of argv, which has to outlive their use.
     void parse(int argc, char** argv);
 
     void parse(int argc, const char** argv);
 
+    // copies the arguments once, they are kept until reset_storage()
     void parse(const ArgumentListType& argv);
 
+    // Parses into `result` and leaves the parser untouched, so a configured parser can be
+    // shared by any number of threads. The result is cleared first but keeps its storage.
+    void parse(int argc, const char* const* argv, Result& result) const;
+
+    // Parses the list in place, the values of `result` refer to `argv`, which has to outlive
+    // their use. A temporary list is moved into the result instead.
+    void parse(const ArgumentListType& argv, Result& result) const;
+
+    void parse(ArgumentListType&& argv, Result& result) const;
+
+    // Like parse(), but reports invalid arguments by the returned status instead of throwing.
+    // The result keeps what was parsed before the first error. With `collect_all` parsing goes
+    // on after errors, so that a single pass reports as many of them as possible.
+    ParseStatus try_parse(int argc, const char* const* argv, Result& result, bool collect_all = false) const;
+
+    ParseStatus try_parse(const ArgumentListType& argv, Result& result, bool collect_all = false) const;
+
+    ParseStatus try_parse(ArgumentListType&& argv, Result& result, bool collect_all = false) const;
+
+    // Splits `command_line` like a POSIX shell, i.e. by whitespace, quotes and backslashes,
+    // but without expanding variables, globs or the like. Its first word is the program name.
+    // The line is copied once and kept until reset_storage().
+    void parse_command_line(std::string_view command_line);
+
+    // the values refer to `command_line`, which has to outlive their use
+    void parse_command_line(std::string_view command_line, Result& result) const;
+
+    ParseStatus try_parse_command_line(std::string_view command_line, Result& result,
+                                       bool collect_all = false) const;
+
     bool is_parsed(const OptionNameType& name) const;
 
     void reset_storage();
 
     template<typename T>
     T get(const OptionNameType& name) const {
-        const auto& option = find_option(name);
-        if (option.number_of_arguments() != 0 && option.number_of_arguments() != 1) {
-            throw UsageException("Invalid number of arguments used for getting the option");
-        }
-        auto storage = option.get<T>();
-        return storage[0];
+        return get_value<T>(m_result, name);
     }
 
     template<typename T>
     std::vector<T> get_n(const OptionNameType& name) const {
-        const auto& option = find_option(name);
-        return option.get<T>();
+        return get_values<T>(m_result, name);
     }
 
+    // position of the value within the ordered choices of an option, found while parsing;
+    // throws a UsageException for choices given as unordered sets
+    std::size_t get_choice_index(const OptionNameType& name) const;
+
+    std::vector<std::size_t> get_choice_indices(const OptionNameType& name) const;
+
     void set_required(const OptionNameSetType& names);
 
     void set_hidden(const OptionNameSetType& names);
@@ -113,26 +471,175 @@ public:
 
     void add_xor(const OptionNameSetType& names);
 
+    // `name` may only be given together with all of `required_names`, e.g. `--password` with
+    // `--user`. Implications between options are rules of this kind as well.
+    void add_requires(const OptionNameType& name, const OptionNameSetType& required_names);
+
+    void add_at_least_one(const OptionNameSetType& names);
+
+    // all or none of the options have to be given
+    void add_inclusive(const OptionNameSetType& names);
+
     void set_required_positionals(ArgumentCountType minimum_positionals);
 
     void set_allowed_positionals(ArgumentCountType maximum_positionals);
 
     void set_positional_help(const HelpTextType& help, const HelpTextType& meta_var = "POSITIONALS");
 
+    // Hands every positional to `callback` while parsing instead of storing it, so long lists
+    // of positionals can be processed as they are read. The callback refuses a positional by
+    // returning false. The numbers of positionals are checked as before, but too few are only
+    // noticed after the callback has seen all of them.
+    void set_positional_callback(ValueCallback callback);
+
+    // Replaces arguments `@file` by the arguments in `file`, which are separated by whitespace
+    // and may be quoted. Files are mapped and tokenized while parsing, nested response files
+    // are followed up to `maximum_depth` levels.
+    void set_response_files(bool is_enabled, ArgumentCountType maximum_depth = 8);
+
+    // Options not given on the command line are read from `variable` when parsing, its value is
+    // checked like an argument. Options with one argument take the value as is, all others
+    // split it into words like parse_command_line(). Flags are set by a true value.
+    void set_environment_variable(const OptionNameType& name, const std::string& variable);
+
+    // Accepts unambiguous prefixes of long option names while parsing, like `--verb` for
+    // `--verbose`. Prefixes matching several options are reported as ambiguous.
+    void set_abbreviations(bool is_allowed);
+
+    // Names of the visible options starting with `prefix`, with their dashes and sorted, e.g.
+    // for shell completion. `-` and an empty prefix give all names, a prefix without a dash none.
+    std::vector<OptionNameType> complete(std::string_view prefix) const;
+
     bool has_positionals() const;
 
     const StorageType& get_positionals() const;
 
-    std::string help() const;
+    // positionals without copying them out of the parsed arguments
+    const ArgumentViewListType& get_positional_views() const;
+
+    using SubcommandFactory = std::function<void(argument_parser& parser)>;
+
+    // The first positional argument names a subcommand, whose parser is configured by `factory`
+    // when the subcommand is used first. It parses all further arguments, which may still
+    // contain the options of this parser. Arguments after "--" are never subcommands.
+    void add_subcommand(const std::string& name, const HelpTextType& help, SubcommandFactory factory);
+
+    // builds the parser of a subcommand if necessary
+    const argument_parser& get_subcommand_parser(const std::string& name) const;
+
+    // empty if no subcommand was given
+    ArgumentViewType get_subcommand() const;
+
+    const Result& get_subcommand_result() const;
+
+    // Rendered once and kept until an option is added or a setter changes what the help shows,
+    // e.g. set_required() or set_help_width(). The reference stays valid until then.
+    const std::string& help() const;
+
+    const std::string& help(const std::string& subcommand) const;
+
+    // Wraps the help texts of options and subcommands at `width` columns, e.g. the width of the
+    // terminal. 0 never wraps, which is the default.
+    void set_help_width(std::size_t width);
 
 private:
+    // value of an option with a declared type, converted once from its argument text
+    union TypedValue {
+        bool boolean;
+        long long integer;
+        unsigned long long unsigned_integer;
+        long double floating_point;
+    };
+
+    // parsed values of one option, owned by a Result
+    struct OptionState {
+        inline bool is_parsed() const { return !values.empty() || (consumed != 0); }
+
+        ArgumentViewListType values;
+        std::size_t consumed{0};  // values handed to the callback of the option instead
+        std::vector<TypedValue> typed_values;  // only for options with a declared type
+        std::vector<std::size_t> choice_indices;  // only for options with choices
+    };
+
+    // Choices of one argument in a fixed order, found by an open addressing hash table of
+    // their positions.
+    class ChoiceSet {
+    public:
+        static const std::size_t npos{std::numeric_limits<std::size_t>::max()};
+
+        explicit ChoiceSet(std::vector<StorageValueType> choices);
+
+        // position of `value` in choices(), npos if it is no choice
+        std::size_t find(ArgumentViewType value) const;
+
+        inline const std::vector<StorageValueType>& choices() const { return m_choices; }
+
+    private:
+        std::vector<StorageValueType> m_choices;
+        std::vector<std::size_t> m_slots;  // npos marks an empty slot
+    };
+
+    // Owns the text of arguments that are no plain views, e.g. unquoted tokens. Handed out
+    // views stay valid until clear(), which keeps the allocated blocks.
+    class TextArena {
+    public:
+        // room for at least `size` characters, the first `used` of them are kept by commit()
+        char* reserve(std::size_t size);
+
+        ArgumentViewType commit(std::size_t used);
+
+        void clear();
+
+    private:
+        struct Block {
+            std::unique_ptr<char[]> data;
+            std::size_t capacity;
+        };
+
+        std::vector<Block> m_blocks;
+        std::size_t m_block{0};
+        std::size_t m_used{0};
+    };
+
+    // Stores each distinct text of the spec once, e.g. names, help texts and meta vars. The
+    // views stay valid for the lifetime of the pool.
+    class StringPool {
+    public:
+        std::string_view intern(std::string_view text);
+
+    private:
+        TextArena m_arena;
+        std::unordered_set<std::string_view> m_texts;
+    };
+
+    class ResponseFile;
+
+    // Spec of an option as needed for parsing, the texts for the help are kept in OptionTexts.
     class Option {
     public:
-        explicit Option(ArgumentCountType number_of_arguments, ChoiceStorageType choices = {});
+        explicit Option(ArgumentCountType number_of_arguments, const ChoiceStorageType& choices = {});
 
-        void parse(const StorageType& values);
+        Option(ArgumentCountType number_of_arguments, std::vector<ChoiceSet> choices);
 
-        void set_appending(bool is_appending);
+        template<typename Enum>
+        void set_enum_values(std::vector<long long> values) {
+            m_value_type = &TypeTag<Enum>::id;
+            m_enum_values = std::move(values);
+        }
+
+        template<typename T>
+        void set_value_type() {
+            static_assert(std::is_fundamental<T>::value ||
+                          std::is_same<T, std::string>::value, "Use fundamental type as option value type");
+            m_value_type = &TypeTag<T>::id;
+            m_convert = std::is_same<T, std::string>::value ? nullptr : &convert<T>;
+            convert_defaults();
+        }
+
+        // stores the values or leaves the state untouched and describes the problem in `error`
+        bool parse(const ArgumentViewListType& values, OptionState& state, ParseError& error) const;
+
+        inline void set_appending(bool is_appending) { m_is_appending = is_appending; }
 
         inline bool is_appending() const { return m_is_appending; }
 
@@ -144,122 +651,560 @@ private:
 
         inline bool is_required() const { return m_is_required; }
 
-        void set_default(const StorageType& values);
+        // false if the choices came as unordered sets, whose indices follow no given order
+        inline bool has_ordered_choices() const { return m_has_ordered_choices; }
 
-        void set_meta_vars(const MetaVarListType& meta_vars);
+        void set_default(const StorageType& values);
 
-        inline void set_help(const HelpTextType& help) { m_help = help; }
+        inline void set_callback(ValueCallback callback) { m_callback = std::move(callback); }
 
-        void set_names(const OptionNameSetType& names);
+        inline bool has_callback() const { return static_cast<bool>(m_callback); }
 
-        inline bool has_name(const OptionNameType& name) const;
+        // hands the default values to the callback, false and the problem in `error` if one is refused
+        bool apply_defaults(ParseError& error) const;
 
-        inline void reset_storage() { m_storage.clear(); }
+        // one of the names, interned by the parser
+        inline void set_name(std::string_view name) { m_name = name; }
 
         inline bool has_default() const { return !m_default_storage.empty(); }
 
         inline ArgumentCountType number_of_arguments() const { return m_number_of_arguments; }
 
-        inline bool is_parsed() const { return (!m_storage.empty()); }
-
-        inline std::string get_name() const;
+        inline std::string_view get_name() const { return m_name; }
 
         template<typename T>
-        const std::vector<T> get() const {
-            static_assert(std::is_fundamental<T>::value ||
+        const std::vector<T> get(const OptionState& state) const {
+            static_assert(std::is_fundamental<T>::value || std::is_enum<T>::value ||
                           std::is_same<T, std::string>::value, "Use fundamental type to get option");
 
+            const auto count = active_size(state);
             std::vector<T> storage;
-            const StorageType* ref_storage;
-            if (is_parsed()) {
-                ref_storage = &m_storage;
-            } else if (has_default()) {
-                ref_storage = &m_default_storage;
-            } else {
-                throw ParsingException("Failed to get unparsed error");
+            storage.reserve(count);
+            for (StorageType::size_type i = 0; i < count; ++i) {
+                storage.emplace_back(get_value<T>(state, i));
             }
+            return storage;
+        }
 
-            for (auto& ref_value : (*ref_storage)) {
+        template<typename T>
+        T get_value(const OptionState& state, StorageType::size_type index) const {
+            static_assert(std::is_fundamental<T>::value || std::is_enum<T>::value ||
+                          std::is_same<T, std::string>::value, "Use fundamental type to get option");
+
+            if constexpr (std::is_enum<T>::value) {
+                if (m_value_type != &TypeTag<T>::id) {
+                    throw UsageException("Option '" + std::string(get_name()) +
+                                         "' has no choices of the requested enum type");
+                }
+                return static_cast<T>(m_enum_values[choice_index(state, index)]);
+            } else {
+                const auto text = active_text(state, index);
+                if constexpr (!std::is_same<T, std::string>::value) {
+                    if (m_convert != nullptr && m_value_type == &TypeTag<T>::id) {
+                        return from_typed<T>((state.is_parsed() ? state.typed_values : m_typed_default_storage)[index]);
+                    }
+                }
                 T value;
-                parse_value(ref_value, value);
-                storage.emplace_back(value);
+                parse_value(text, value);
+                return value;
             }
-            return storage;
         }
 
-        std::pair<std::string, std::string> generate_help_text() const;
+        std::size_t choice_index(const OptionState& state, StorageType::size_type index) const;
+
+        static void parse_value(ArgumentViewType text, bool& value);
+
+        template<typename T>
+        static bool try_parse_value(ArgumentViewType text, T& value) {
+            std::istringstream is{StorageValueType(text)};
+            return (is >> value) && (is.rdbuf()->in_avail() == 0);
+        }
+
+        static bool try_parse_value(ArgumentViewType text, bool& value);
+
+        static bool try_parse_value(ArgumentViewType text, std::string& value);
+
+        // number of parsed values, or of default values if unparsed
+        StorageType::size_type active_size(const OptionState& state) const;
+
+        // appends the properties of the option like ` (required, default: 1)`, if it has any
+        void append_help_properties(std::string& text, std::string_view environment_variable) const;
 
     protected:
+        using ConvertFunction = bool (*)(ArgumentViewType text, TypedValue& typed);
+
+        // the address of `id` identifies the declared value type of an option
+        template<typename T>
+        struct TypeTag {
+            static constexpr char id{0};
+        };
+
+        // fills `typed` in place, the union holds a long double and is not passed by value
         template<typename T>
-        static void parse_value(const StorageValueType& text, T& value) {
-            std::istringstream is(text);
-            if (!(is >> value) || (is.rdbuf()->in_avail() != 0)) {
-                throw ParsingException("Argument ‘" + text + "’ failed to parse");
+        static void to_typed(T value, TypedValue& typed) {
+            if constexpr (std::is_same<T, bool>::value) {
+                typed.boolean = value;
+            } else if constexpr (std::is_floating_point<T>::value) {
+                typed.floating_point = value;
+            } else if constexpr (std::is_signed<T>::value) {
+                typed.integer = value;
+            } else {
+                typed.unsigned_integer = value;
             }
         }
 
-        static void parse_value(const StorageValueType& text, bool& value);
+        template<typename T>
+        static T from_typed(const TypedValue& typed) {
+            if constexpr (std::is_same<T, bool>::value) {
+                return typed.boolean;
+            } else if constexpr (std::is_floating_point<T>::value) {
+                return static_cast<T>(typed.floating_point);
+            } else if constexpr (std::is_signed<T>::value) {
+                return static_cast<T>(typed.integer);
+            } else {
+                return static_cast<T>(typed.unsigned_integer);
+            }
+        }
 
-        static void parse_value(const StorageValueType& text, std::string& value);
+        template<typename T>
+        static bool convert(ArgumentViewType text, TypedValue& typed) {
+            if constexpr (!std::is_same<T, std::string>::value) {
+                T value;
+                if (!try_parse_value(text, value)) {
+                    return false;
+                }
+                to_typed(value, typed);
+            }
+            return true;
+        }
 
-        OptionNameSetType m_names;
-        HelpTextType m_help;
-        MetaVarListType m_meta_vars;
-        ArgumentCountType m_number_of_arguments{0};
-        StorageType m_storage{};
+        ArgumentViewType active_text(const OptionState& state, StorageType::size_type index) const;
+
+        // values handed to a callback can not be read afterwards
+        void ensure_stored(const OptionState& state) const;
+
+        void convert_defaults();
+
+        template<typename T>
+        static void parse_value(ArgumentViewType text, T& value) {
+            if (!try_parse_value(text, value)) {
+                throw ParsingException("Argument ‘" + StorageValueType(text) + "’ failed to parse");
+            }
+        }
+
+        static void parse_value(ArgumentViewType text, std::string& value);
+
+        std::string_view m_name;
+        const char* m_value_type{&TypeTag<std::string>::id};
+        ConvertFunction m_convert{nullptr};
         StorageType m_default_storage{};
-        ChoiceStorageType m_choices;
-        bool m_is_appending{false};
-        bool m_is_hidden{false};
-        bool m_is_required{false};
+        std::vector<TypedValue> m_typed_default_storage{};
+        std::vector<ChoiceSet> m_choices;
+        std::vector<std::size_t> m_default_choice_indices{};
+        std::vector<long long> m_enum_values{};  // by choice index, only for enum options
+        ValueCallback m_callback{};
+        ArgumentCountType m_number_of_arguments{0};
+        bool m_is_appending : 1;
+        bool m_is_hidden : 1;
+        bool m_is_required : 1;
+        bool m_has_ordered_choices : 1;
     };
 
     using OptionStorage = std::vector<Option>;
 
+    // texts of an option that only the help needs, interned in m_texts or views into a table
+    struct OptionTexts {
+        std::string_view names;  // with the meta vars, like ` -f --file <FILE>`
+        std::string_view help;
+        std::string_view environment_variable;
+        const option_spec* spec{nullptr};  // of table options, which render the names from it
+    };
+
+    std::size_t help_names_size(std::size_t position) const;
+
+    void append_help_names(std::string& text, std::size_t position) const;
+
+    // names `option` and appends its texts to m_option_texts
+    void add_option_texts(Option& option, const OptionNameSetType& names, std::string_view help,
+                          const MetaVarListType& meta_vars);
+
+    // Maps normalized option names to their position in m_options. Short names use a direct
+    // table indexed by letter, long names an open addressing hash table, lookups never allocate.
+    class OptionIndex {
+    public:
+        static const std::size_t npos{std::numeric_limits<std::size_t>::max()};
+
+        OptionIndex();
+
+        // `name` is referred to and has to outlive the index, e.g. interned in m_texts
+        void insert(std::string_view name, std::size_t position);
+
+        std::size_t find(std::string_view name) const;
+
+        using SortedNameList = std::vector<std::pair<std::string_view, std::size_t>>;
+
+        // long names starting with `prefix` in lexicographic order, found by binary search after
+        // sorting the names once since the last insert
+        std::pair<SortedNameList::const_iterator, SortedNameList::const_iterator>
+        find_prefix(std::string_view prefix) const;
+
+        // consulted before the runtime names, its positions are the first ones in m_options
+        void set_table(const option_table_view& table);
+
+    private:
+        static std::size_t short_slot(char letter);
+
+        void grow();
+
+        // sorts on the first lookup, so that adding n options stays O(n log n)
+        void sort_long_names() const;
+
+        std::array<std::size_t, 52> m_short_positions;
+        std::vector<std::pair<std::string_view, std::size_t>> m_long_slots;  // npos marks an empty slot
+        std::size_t m_number_of_long_names{0};
+        mutable SortedNameList m_sorted_long_names;
+        mutable std::mutex m_sort_mutex;
+        mutable std::atomic<bool> m_is_sorted{true};
+        option_table_view m_table{nullptr, 0, nullptr, nullptr, 0, 0};
+    };
+
+    void insert_option(const OptionNameSetType& names, Option option, const HelpTextType& help,
+                       const MetaVarListType& meta_vars, const StorageType& default_values);
+
     void ensure_valid_option_list(const OptionNameSetType& names) const;
 
-    OptionStorage::iterator find_option_iter(const OptionNameType& name);
+    OptionStorage::iterator find_option_iter(std::string_view name);
+
+    OptionStorage::const_iterator find_option_iter(std::string_view name) const;
+
+    // npos and the reason in `error` if no option is found
+    std::size_t find_option_to_parse(std::string_view name, parse_error& error) const;
+
+    Option& find_option(std::string_view name);
+
+    const Option& find_option(std::string_view name) const;
+
+    // arguments handed to parse(), read in place
+    class ArgumentSource {
+    public:
+        ArgumentSource(int argc, const char* const* argv) : m_argv(argv), m_size(static_cast<std::size_t>(argc)) {}
+
+        explicit ArgumentSource(const ArgumentListType& arguments)
+                : m_arguments(arguments.data()), m_size(arguments.size()) {}
+
+        inline std::size_t size() const { return m_size; }
+
+        inline ArgumentViewType operator[](std::size_t index) const {
+            return (m_argv != nullptr) ? ArgumentViewType(m_argv[index]) : ArgumentViewType(m_arguments[index]);
+        }
+
+    private:
+        const char* const* m_argv{nullptr};
+        const ArgumentType* m_arguments{nullptr};
+        std::size_t m_size;
+    };
+
+    // reads the arguments in order and expands response files
+    class ArgumentStream;
+
+    void parse(const ArgumentSource& argv, Result& result) const;
+
+    void parse(const ArgumentSource& argv, Result& result, ParseStatus& status) const;
+
+    // the first word of the command line is the program name
+    void parse_command_line(std::string_view command_line, Result& result, ParseStatus& status) const;
+
+    // options unknown to a subcommand are looked up in the `parent` parser
+    void parse(ArgumentStream& stream, Result& result, ParseStatus& status, const argument_parser* parent = nullptr,
+               Result* parent_result = nullptr) const;
+
+    struct Subcommand {
+        std::string name;
+        HelpTextType help;
+        SubcommandFactory factory;
+        mutable std::once_flag is_built;
+        mutable std::unique_ptr<argument_parser> parser;
+    };
+
+    // nullptr if there is no such subcommand
+    const Subcommand* find_subcommand(ArgumentViewType name) const;
+
+    const argument_parser& build_subcommand(const Subcommand& subcommand) const;
+
+    bool is_short_option_name(ArgumentViewType arg) const;
+
+    bool is_short_option_group_name(ArgumentViewType arg) const;
+
+    bool is_long_option(ArgumentViewType arg) const;
+
+    // both return a view into `name` without the leading dashes
+    std::string_view strictly_normalize_option_name(std::string_view name) const;
+
+    std::string_view normalize_option_name(std::string_view name) const;
+
+    std::pair<ArgumentViewType, ArgumentViewType> split_argument_text(ArgumentViewType text) const;
+
+    bool is_parsed(const Result& result, std::string_view name) const;
+
+    template<typename T>
+    T get_value(const Result& result, const OptionNameType& name) const {
+        const auto position = find_option_position(name);
+        const auto& option = m_options[position];
+        if (option.number_of_arguments() != 0 && option.number_of_arguments() != 1) {
+            throw UsageException("Invalid number of arguments used for getting the option");
+        }
+        return option.get_value<T>(result.state(position), 0);
+    }
+
+    template<typename T>
+    std::vector<T> get_values(const Result& result, const OptionNameType& name) const {
+        const auto position = find_option_position(name);
+        return m_options[position].get<T>(result.state(position));
+    }
+
+    std::size_t get_choice_index(const Result& result, const OptionNameType& name) const;
+
+    std::vector<std::size_t> get_choice_indices(const Result& result, const OptionNameType& name) const;
 
-    OptionStorage::const_iterator find_option_iter(const OptionNameType& name) const;
+    // fills options without a value from the bound environment variables
+    void parse_environment(Result& result, ParseStatus& status) const;
 
-    Option& find_option_to_parse(const OptionNameType& name);
+    void parse_environment_value(std::size_t position, std::string_view variable, std::string_view value,
+                                 Result& result, ParseStatus& status) const;
 
-    Option& find_option(const OptionNameType& name);
+    // Positions of options as the non-zero words of a bitset over m_options, so that a rule is
+    // checked against the bitset of the parsed options by a few word operations.
+    class OptionMask {
+    public:
+        static const std::size_t npos{std::numeric_limits<std::size_t>::max()};
+
+        using BitSet = std::vector<std::uint64_t>;
+
+        void insert(std::size_t position);
+
+        inline bool empty() const { return m_words.empty(); }
+
+        bool intersects(const BitSet& bits) const;
 
-    const Option& find_option(const OptionNameType& name) const;
+        bool is_subset_of(const BitSet& bits) const;
 
-    bool is_short_option_name(const ArgumentType& arg) const;
+        bool has_several_in(const BitSet& bits) const;
 
-    bool is_short_option_group_name(const ArgumentType& arg) const;
+        // first position from `start` on that is (not) contained in `bits`, npos if there is none
+        std::size_t find(const BitSet& bits, bool is_contained, std::size_t start = 0) const;
 
-    bool is_long_option(const ArgumentType& arg) const;
+    private:
+        std::vector<std::pair<std::size_t, std::uint64_t>> m_words;  // sorted by word index
+    };
+
+    enum class ConstraintType { exclusive, dependency, at_least_one, inclusive };
 
-    OptionNameType strictly_normalize_option_name(const OptionNameType& name) const;
+    struct Constraint {
+        ConstraintType type;
+        std::size_t trigger;  // the option with requirements
+        OptionMask options;
+    };
 
-    OptionNameType normalize_option_name(const OptionNameType& name) const;
+    OptionMask to_mask(const OptionNameSetType& names) const;
 
-    std::pair<OptionNameType, StorageValueType> split_argument_text(const ArgumentType& text) const;
+    void check_required_arguments(const Result& result, ParseStatus& status) const;
 
-    void check_required_arguments() const;
+    void check_constraints(const Result& result, ParseStatus& status) const;
 
-    void check_xor_arguments() const;
+    void set_program_name_from_argv(ArgumentViewType argv0);
 
-    void set_program_name_from_argv(const ArgumentType& argv0);
+    inline void invalidate_help() { m_is_help_valid = false; }
+
+    std::string render_help() const;
 
     HelpTextType m_program_name{};
     HelpTextType m_program_version{};
     HelpTextType m_help_preamble{};
     HelpTextType m_help_epilog{};
+    std::size_t m_help_width{0};
+    mutable std::mutex m_help_mutex;
+    mutable std::string m_help_text;  // cached by help()
+    mutable bool m_is_help_valid{false};
 
     ArgumentCountType m_number_of_minimum_positionals{0};
     ArgumentCountType m_number_of_maximum_positionals{0};
     HelpTextType m_positional_help{};
     HelpTextType m_positional_meta_var{};
+    ValueCallback m_positional_callback{};
+
+    OptionMask m_required_options;
+    std::vector<Constraint> m_constraints;
 
-    StorageType m_positionals;
-    std::vector<OptionNameSetType> m_xor_lists;
+    std::unordered_map<std::string_view, std::size_t> m_environment_index;  // names interned in m_texts
 
+    std::vector<std::unique_ptr<Subcommand>> m_subcommands;
+
+    std::vector<std::size_t> m_bound_positions;  // of options with a callback
+
+    bool m_is_allowing_abbreviations{false};
+    bool m_is_expanding_response_files{false};
+    ArgumentCountType m_maximum_response_file_depth{8};
+
+    StringPool m_texts;
     OptionStorage m_options;
+    std::vector<OptionTexts> m_option_texts;  // by position in m_options
+    OptionIndex m_option_index;
+
+public:
+    // Outcome of one parse: values of all options and the positionals. The values refer to
+    // the parsed arguments, clear() keeps the allocated storage for the next parse.
+    class Result {
+    public:
+        Result() = default;
+
+        // the values may refer to storage of the result
+        Result(const Result&) = delete;
+
+        Result(Result&&) = default;
+
+        Result& operator=(const Result&) = delete;
+
+        Result& operator=(Result&&) = default;
+
+        bool is_parsed(const OptionNameType& name) const;
+
+        template<typename T>
+        T get(const OptionNameType& name) const {
+            return parser().get_value<T>(*this, name);
+        }
+
+        template<typename T>
+        std::vector<T> get_n(const OptionNameType& name) const {
+            return parser().get_values<T>(*this, name);
+        }
+
+        std::size_t get_choice_index(const OptionNameType& name) const;
+
+        std::vector<std::size_t> get_choice_indices(const OptionNameType& name) const;
+
+        inline bool has_positionals() const { return m_number_of_positionals != 0; }
+
+        // including those handed to the positional callback, which are not stored
+        inline std::size_t number_of_positionals() const { return m_number_of_positionals; }
+
+        const StorageType& get_positionals() const;
+
+        inline const ArgumentViewListType& get_positional_views() const { return m_positionals; }
+
+        // argv[0] of the parsed arguments
+        inline ArgumentViewType program_name() const { return m_program_name; }
+
+        inline ArgumentViewType get_subcommand() const { return m_subcommand; }
+
+        // throws a UsageException if no subcommand was given
+        const Result& get_subcommand_result() const;
+
+        void clear();
+
+    private:
+        friend class argument_parser;
+
+        const argument_parser& parser() const;
+
+        // options added after the last parse have not been parsed
+        const OptionState& state(std::size_t position) const;
+
+        inline void mark_parsed(std::size_t position) {
+            m_parsed_options[position / 64] |= std::uint64_t(1) << (position % 64);
+        }
+
+        const argument_parser* m_parser{nullptr};  // the parser of the last parse
+        std::vector<OptionState> m_options;
+        std::vector<std::uint64_t> m_parsed_options;  // bitset by position of the options
+        ArgumentViewListType m_positionals;
+        std::size_t m_number_of_positionals{0};
+        mutable StorageType m_positional_copies;  // filled on demand by get_positionals()
+        // backs the views of parse(const ArgumentListType&) and of temporary lists, a deque so
+        // that they stay valid when appending
+        std::deque<ArgumentListType> m_copied_arguments;
+        ArgumentViewListType m_values;  // reused while collecting the values of one option
+        TextArena m_arena;  // unquoted arguments and copied command lines
+        std::vector<std::shared_ptr<const ResponseFile>> m_response_files;
+        ArgumentViewType m_program_name;
+        ArgumentViewType m_subcommand;
+        std::unique_ptr<Result> m_subcommand_result;  // kept with its storage once allocated
+    };
+
+    // One problem found by try_parse(). The views refer to the parsed arguments and to the
+    // options of the parser, the message is only formatted by message().
+    struct ParseError {
+        static const std::size_t npos{std::numeric_limits<std::size_t>::max()};
+
+        std::string message() const;
+
+        parse_error code{parse_error::none};
+        std::size_t argument_index{npos};  // in argv or the words of a command line, npos if none
+        ArgumentViewType argument{};  // the offending argument or value
+        ArgumentViewType option{};  // name of the option without dashes
+        ArgumentViewType detail{};  // the conflicting option or the unclosed quote
+        std::size_t expected{0};  // number of arguments, positionals or response file levels
+        std::size_t given{0};
+        ArgumentViewType variable{};  // the environment variable the value was read from
+        std::size_t constraint{npos};  // position of the violated rule
+        const argument_parser* parser{nullptr};  // whose options were parsed
+    };
+
+    // Outcome of try_parse(), without errors if the arguments are valid.
+    class ParseStatus {
+    public:
+        inline bool ok() const { return m_errors.empty(); }
+
+        inline explicit operator bool() const { return ok(); }
+
+        inline const std::vector<ParseError>& errors() const { return m_errors; }
+
+        // of the first error, parse_error::none or npos if there is none
+        parse_error code() const;
+
+        std::size_t argument_index() const;
+
+        ArgumentViewType option() const;
+
+        // message of the first error as thrown by parse(), missing required options are listed together
+        std::string message() const;
+
+    private:
+        friend class argument_parser;
+
+        // a fatal error ends parsing even if all errors are collected
+        void report(ParseError error, bool is_fatal = false);
+
+        inline bool is_done() const { return m_is_stopped || (!m_is_collecting_all && !m_errors.empty()); }
+
+        std::vector<ParseError> m_errors;
+        bool m_is_collecting_all{false};
+        bool m_is_stopped{false};
+    };
+
+    // outcome of one argument list of parse_batch(), `error` is empty if it was parsed
+    struct BatchEntry {
+        inline bool is_valid() const { return error.empty(); }
+
+        Result result;
+        std::string error;
+    };
+
+    using BatchResultList = std::vector<BatchEntry>;
+
+    // Parses every argument list on up to `number_of_threads` threads (0: one per core) and
+    // never throws for invalid lists. The results refer to `argument_lists`. Bound callbacks
+    // and variables are shared by all threads, so they have to be thread-safe.
+    BatchResultList parse_batch(const std::vector<ArgumentListType>& argument_lists,
+                                unsigned number_of_threads = 0) const;
+
+    // refills the entries of a previous batch, keeping their storage
+    void parse_batch(const std::vector<ArgumentListType>& argument_lists, BatchResultList& entries,
+                     unsigned number_of_threads = 0) const;
+
+private:
+    Result m_result;  // of parse() without an explicit result
 };
 
+using parse_result = argument_parser::Result;
+
 } // namespace utils
@@ -0,0 +1,473 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "argument_parser.h"
+
+using ArgumentParser = utils::argument_parser;
+
+namespace {
+// spec of a typical tool: flags, valued options, choices and positionals
+void add_tool_options(ArgumentParser& parser) {
+    parser.add_flag({"-v", "--verbose"}, "verbose output");
+    parser.add_flag({"-q", "--quiet"}, "no output");
+    parser.add_flag({"-f", "--force"}, "overwrite files");
+    parser.add_option<int>({"-j", "--jobs"}, "parallel jobs", "N", "1");
+    parser.add_option({"-o", "--output"}, "output file", "FILE", "a.out");
+    parser.add_option({"-I", "--include"}, "include directory", "DIR");
+    parser.add_option({"-m", "--mode"}, 1, "build mode", {"MODE"}, {"debug"}, {{"debug", "release", "profile"}});
+    parser.add_option<double>({"--timeout"}, "timeout in seconds", "SECONDS", "60");
+    parser.set_appending_arguments({"include"});
+    parser.add_xor({"verbose", "quiet"});
+    parser.set_allowed_positionals(ArgumentParser::unlimited_positionals);
+}
+
+// every 16th list is invalid, as stored command lines of an outdated spec would be
+std::vector<ArgumentParser::ArgumentListType> make_argument_lists(std::size_t count) {
+    std::vector<ArgumentParser::ArgumentListType> lists;
+    lists.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        ArgumentParser::ArgumentListType list{"tool", "-vf", "--jobs=" + std::to_string(i % 64 + 1),
+                                              "-o", "out_" + std::to_string(i), "-I", "include",
+                                              "-I", "third_party/include", "--mode", "release"};
+        if (i % 16 == 15) {
+            list.emplace_back("--removed-option");
+        }
+        list.emplace_back("--");
+        for (std::size_t j = 0; j < 4; ++j) {
+            list.emplace_back("source_" + std::to_string(j) + ".cpp");
+        }
+        lists.emplace_back(std::move(list));
+    }
+    return lists;
+}
+
+// text of a valid value of T, get<T>() reads it back
+template<typename T>
+std::string value_text();
+
+template<>
+std::string value_text<int>() { return "4096"; }
+
+template<>
+std::string value_text<double>() { return "0.125"; }
+
+template<>
+std::string value_text<bool>() { return "true"; }
+
+template<>
+std::string value_text<std::string>() { return "build/output"; }
+
+std::vector<const char*> to_argv(const ArgumentParser::ArgumentListType& arguments) {
+    std::vector<const char*> argv;
+    argv.reserve(arguments.size());
+    for (const auto& argument : arguments) {
+        argv.push_back(argument.c_str());
+    }
+    return argv;
+}
+
+void thread_counts(benchmark::internal::Benchmark* bench) {
+    const auto cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads < cores; threads *= 2) {
+        bench->Args({1 << 14, threads});
+    }
+    bench->Args({1 << 14, cores});
+}
+}
+
+// a parser with flags, valued options and choices declared and destroyed again
+static void BM_BuildSpec(benchmark::State& state) {
+    const auto number_of_options = state.range(0);
+    for (auto _ : state) {
+        ArgumentParser parser;
+        for (std::int64_t i = 0; i < number_of_options; ++i) {
+            const auto name = std::to_string(i);
+            switch (i % 4) {
+                case 0:
+                    parser.add_flag({"--flag-" + name}, "enables feature " + name);
+                    break;
+                case 1:
+                    parser.add_option<int>({"--count-" + name}, "count of " + name, "N", "1");
+                    break;
+                case 2:
+                    parser.add_option({"--mode-" + name}, 1, "mode of " + name, {"MODE"}, {"fast"},
+                                      {{"fast", "small", "safe"}});
+                    break;
+                default:
+                    parser.add_option({"--path-" + name}, "path of " + name, "PATH");
+                    break;
+            }
+        }
+        benchmark::DoNotOptimize(parser);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * number_of_options));
+}
+BENCHMARK(BM_BuildSpec)->ArgName("options")->Arg(16)->Arg(1 << 12)->Unit(benchmark::kMicrosecond);
+
+static void BM_ParseBatch(benchmark::State& state) {
+    ArgumentParser parser;
+    add_tool_options(parser);
+    const auto lists = make_argument_lists(static_cast<std::size_t>(state.range(0)));
+    const auto threads = static_cast<unsigned>(state.range(1));
+    ArgumentParser::BatchResultList entries;
+    for (auto _ : state) {
+        parser.parse_batch(lists, entries, threads);
+        benchmark::DoNotOptimize(entries.data());
+    }
+    state.counters["parses_per_second"] = benchmark::Counter(
+            static_cast<double>(state.iterations() * lists.size()), benchmark::Counter::kIsRate);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * lists.size()));
+}
+BENCHMARK(BM_ParseBatch)
+        ->ArgNames({"lists", "threads"})
+        ->Apply(thread_counts)
+        ->UseRealTime()
+        ->Unit(benchmark::kMillisecond);
+
+static void BM_ParseSequential(benchmark::State& state) {
+    ArgumentParser parser;
+    add_tool_options(parser);
+    const auto lists = make_argument_lists(static_cast<std::size_t>(state.range(0)));
+    utils::parse_result result;
+    for (auto _ : state) {
+        for (const auto& list : lists) {
+            try {
+                parser.parse(list, result);
+            } catch (const utils::ParsingException&) {
+            }
+            benchmark::DoNotOptimize(result);
+        }
+    }
+    state.counters["parses_per_second"] = benchmark::Counter(
+            static_cast<double>(state.iterations() * lists.size()), benchmark::Counter::kIsRate);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * lists.size()));
+}
+BENCHMARK(BM_ParseSequential)->ArgName("lists")->Arg(1 << 14)->Unit(benchmark::kMillisecond);
+
+// `--option-i value` for half as many options as there are arguments
+static void BM_ParseArguments(benchmark::State& state) {
+    const auto number_of_arguments = state.range(0);
+    ArgumentParser parser;
+    ArgumentParser::ArgumentListType arguments{"tool"};
+    for (std::int64_t i = 0; i < number_of_arguments / 2; ++i) {
+        const auto name = "option-" + std::to_string(i);
+        parser.add_option({"--" + name}, "option " + name, "VALUE");
+        arguments.push_back("--" + name);
+        arguments.push_back("value_" + std::to_string(i));
+    }
+    const auto argv = to_argv(arguments);
+    utils::parse_result result;
+    for (auto _ : state) {
+        parser.parse(static_cast<int>(argv.size()), argv.data(), result);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * number_of_arguments));
+}
+BENCHMARK(BM_ParseArguments)
+        ->ArgName("arguments")
+        ->Arg(10)
+        ->Arg(1000)
+        ->Arg(100000)
+        ->Unit(benchmark::kMicrosecond);
+
+// single letter flags given as groups like `-abc`, each letter once
+static void BM_ShortOptionGroups(benchmark::State& state) {
+    const std::string letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    const auto group_size = static_cast<std::size_t>(state.range(0));
+    ArgumentParser parser;
+    for (const auto letter : letters) {
+        parser.add_flag({std::string(1, '-') + letter});
+    }
+    ArgumentParser::ArgumentListType arguments{"tool"};
+    for (std::size_t i = 0; i < letters.size(); i += group_size) {
+        arguments.push_back("-" + letters.substr(i, group_size));
+    }
+    const auto argv = to_argv(arguments);
+    utils::parse_result result;
+    for (auto _ : state) {
+        parser.parse(static_cast<int>(argv.size()), argv.data(), result);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * letters.size()));
+}
+BENCHMARK(BM_ShortOptionGroups)->ArgName("group_size")->Arg(1)->Arg(4)->Arg(52);
+
+// mostly invalid lists, validated by exceptions or by try_parse()
+static void BM_ValidateInvalid(benchmark::State& state) {
+    ArgumentParser parser;
+    add_tool_options(parser);
+    auto lists = make_argument_lists(static_cast<std::size_t>(state.range(0)));
+    for (std::size_t i = 0; i < lists.size(); ++i) {
+        if (i % 4 != 0) {
+            lists[i].insert(lists[i].begin() + 1, "--removed-option");
+        }
+    }
+    const bool is_throwing = state.range(1) != 0;
+    utils::parse_result result;
+    std::size_t invalid = 0;
+    for (auto _ : state) {
+        invalid = 0;
+        for (const auto& list : lists) {
+            if (is_throwing) {
+                try {
+                    parser.parse(list, result);
+                } catch (const utils::ParsingException&) {
+                    ++invalid;
+                }
+            } else {
+                invalid += parser.try_parse(list, result).ok() ? 0 : 1;
+            }
+        }
+        benchmark::DoNotOptimize(invalid);
+    }
+    state.counters["invalid"] = static_cast<double>(invalid);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * lists.size()));
+}
+BENCHMARK(BM_ValidateInvalid)
+        ->ArgNames({"lists", "throwing"})
+        ->Args({1 << 14, 1})
+        ->Args({1 << 14, 0})
+        ->Unit(benchmark::kMillisecond);
+
+// an appending option given many times, read by get_n() or bound to a container
+static void BM_AppendingOption(benchmark::State& state) {
+    ArgumentParser parser;
+    add_tool_options(parser);
+    std::vector<std::string> includes;
+    const bool is_bound = state.range(1) != 0;
+    if (is_bound) {
+        parser.bind("include", includes);
+    }
+    ArgumentParser::ArgumentListType list{"tool"};
+    for (std::int64_t i = 0; i < state.range(0); ++i) {
+        list.emplace_back("-I");
+        list.emplace_back("include/dir_" + std::to_string(i));
+    }
+    std::vector<const char*> argv;
+    for (const auto& argument : list) {
+        argv.push_back(argument.c_str());
+    }
+    utils::parse_result result;
+    for (auto _ : state) {
+        includes.clear();
+        parser.parse(static_cast<int>(argv.size()), argv.data(), result);
+        if (!is_bound) {
+            includes = result.get_n<std::string>("include");
+        }
+        benchmark::DoNotOptimize(includes.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK(BM_AppendingOption)
+        ->ArgNames({"values", "bound"})
+        ->Args({1 << 15, 0})
+        ->Args({1 << 15, 1})
+        ->Unit(benchmark::kMillisecond);
+
+// an appending option with many choices given many times, each value is checked
+static void BM_Choices(benchmark::State& state) {
+    const auto number_of_choices = static_cast<std::size_t>(state.range(0));
+    std::vector<std::string> choices;
+    for (std::size_t i = 0; i < number_of_choices; ++i) {
+        choices.push_back("target_" + std::to_string(i));
+    }
+    ArgumentParser parser;
+    parser.add_option({"-t", "--target"}, 1, "build target", {"TARGET"}, {},
+                      {{choices.begin(), choices.end()}});
+    parser.set_appending_arguments({"target"});
+    ArgumentParser::ArgumentListType arguments{"tool"};
+    for (std::size_t i = 0; i < 1024; ++i) {
+        arguments.push_back("--target=" + choices[(i * 7919) % number_of_choices]);
+    }
+    const auto argv = to_argv(arguments);
+    utils::parse_result result;
+    for (auto _ : state) {
+        parser.parse(static_cast<int>(argv.size()), argv.data(), result);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * (arguments.size() - 1)));
+}
+BENCHMARK(BM_Choices)->ArgName("choices")->Arg(4)->Arg(1 << 12)->Unit(benchmark::kMicrosecond);
+
+// get<T>() of a single value or get_n<T>() of an appending option with 64 values
+template<typename T>
+static void BM_Get(benchmark::State& state) {
+    const bool is_list = state.range(0) != 0;
+    ArgumentParser parser;
+    parser.add_option<T>({"--value"}, "value");
+    parser.set_appending_arguments({"value"});
+    ArgumentParser::ArgumentListType arguments{"tool"};
+    for (std::size_t i = 0; i < (is_list ? 64 : 1); ++i) {
+        arguments.push_back("--value");
+        arguments.push_back(value_text<T>());
+    }
+    utils::parse_result result;
+    parser.parse(arguments, result);
+    for (auto _ : state) {
+        if (is_list) {
+            auto values = result.get_n<T>("value");
+            benchmark::DoNotOptimize(values);
+        } else {
+            auto value = result.get<T>("value");
+            benchmark::DoNotOptimize(value);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * (arguments.size() - 1) / 2));
+}
+BENCHMARK_TEMPLATE(BM_Get, int)->ArgName("list")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_Get, double)->ArgName("list")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_Get, bool)->ArgName("list")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_Get, std::string)->ArgName("list")->Arg(0)->Arg(1);
+
+// `tool -- file...`, positionals stored in the result or handed to a callback
+static void BM_Positionals(benchmark::State& state) {
+    ArgumentParser parser;
+    add_tool_options(parser);
+    std::size_t total_length = 0;
+    if (state.range(1) != 0) {
+        parser.set_positional_callback([&total_length](std::string_view file) {
+            total_length += file.size();
+            return true;
+        });
+    }
+    std::vector<std::string> arguments{"tool", "-v", "--"};
+    for (std::int64_t i = 0; i < state.range(0); ++i) {
+        arguments.emplace_back("src/file_" + std::to_string(i) + ".cpp");
+    }
+    std::vector<const char*> argv;
+    for (const auto& argument : arguments) {
+        argv.push_back(argument.c_str());
+    }
+    utils::parse_result result;
+    for (auto _ : state) {
+        parser.parse(static_cast<int>(argv.size()), argv.data(), result);
+        for (const auto file : result.get_positional_views()) {
+            total_length += file.size();
+        }
+        benchmark::DoNotOptimize(total_length);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK(BM_Positionals)
+        ->ArgNames({"positionals", "callback"})
+        ->Args({1 << 21, 0})
+        ->Args({1 << 21, 1})
+        ->Unit(benchmark::kMillisecond);
+
+// flags in xor pairs, every 8th of them required and given
+static void BM_CheckConstraints(benchmark::State& state) {
+    const auto number_of_options = static_cast<std::size_t>(state.range(0));
+    ArgumentParser parser;
+    ArgumentParser::OptionNameSetType required;
+    ArgumentParser::ArgumentListType arguments{"tool"};
+    for (std::size_t i = 0; i < number_of_options; ++i) {
+        parser.add_flag({"--flag-" + std::to_string(i)});
+        if (i % 8 == 0) {
+            required.insert("flag-" + std::to_string(i));
+            arguments.push_back("--flag-" + std::to_string(i));
+        }
+    }
+    for (std::size_t i = 0; i + 1 < number_of_options; i += 2) {
+        parser.add_xor({"flag-" + std::to_string(i), "flag-" + std::to_string(i + 1)});
+    }
+    parser.set_required(required);
+    std::vector<const char*> argv;
+    for (const auto& argument : arguments) {
+        argv.push_back(argument.c_str());
+    }
+    utils::parse_result result;
+    for (auto _ : state) {
+        parser.parse(static_cast<int>(argv.size()), argv.data(), result);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_CheckConstraints)
+        ->ArgName("options")
+        ->Arg(64)
+        ->Arg(4096)
+        ->Arg(1 << 16)
+        ->Unit(benchmark::kMicrosecond);
+
+// help of a parser with many options, `cached` renders it again only after a change
+static void BM_Help(benchmark::State& state) {
+    ArgumentParser parser;
+    parser.set_program_info("tool", "1.0");
+    for (std::int64_t i = 0; i < state.range(0); ++i) {
+        const auto name = std::to_string(i);
+        if (i % 4 == 0) {
+            parser.add_flag({"--flag-" + name}, "enables feature " + name + " of the tool");
+        } else {
+            parser.add_option({"--option-" + name}, "sets the value " + name + " that is used by the tool",
+                              "VALUE", name);
+        }
+    }
+    const bool is_cached = state.range(1) != 0;
+    std::size_t size = 0;
+    for (auto _ : state) {
+        if (!is_cached) {
+            parser.set_positional_help("files", "FILE...");  // invalidates the help text
+        }
+        size += parser.help().size();
+    }
+    benchmark::DoNotOptimize(size);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_Help)->ArgNames({"options", "cached"})->Args({5000, 0})->Args({5000, 1})->Unit(benchmark::kMicrosecond);
+
+static void BM_ParseCommandLine(benchmark::State& state) {
+    ArgumentParser parser;
+    add_tool_options(parser);
+    std::string command_line = "tool -vf --jobs 8 -o 'build output' -I include --mode=release --";
+    for (std::int64_t i = 0; i < state.range(0); ++i) {
+        command_line += " src/file_" + std::to_string(i) + ".cpp";
+    }
+    utils::parse_result result;
+    for (auto _ : state) {
+        parser.parse_command_line(command_line, result);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * command_line.size()));
+}
+BENCHMARK(BM_ParseCommandLine)->ArgName("positionals")->Arg(8)->Arg(1 << 12);
+
+static void BM_ParseResponseFile(benchmark::State& state) {
+    const std::string path = "argument_parser_bench.rsp";
+    const auto entries = static_cast<std::size_t>(state.range(0));
+    std::size_t bytes = 0;
+    {
+        std::ofstream file(path);
+        file << "-vf --jobs 8 -o out --\n";
+        for (std::size_t i = 0; i < entries; ++i) {
+            const auto line = (state.range(1) != 0 ? "'src/file " : "src/file_") + std::to_string(i) +
+                              (state.range(1) != 0 ? ".cpp'\n" : ".cpp\n");
+            file << line;
+            bytes += line.size();
+        }
+    }
+    ArgumentParser parser;
+    add_tool_options(parser);
+    parser.set_response_files(true);
+    const char* argv[] = {"tool", "@argument_parser_bench.rsp"};
+    utils::parse_result result;
+    for (auto _ : state) {
+        parser.parse(2, argv, result);
+        benchmark::DoNotOptimize(result);
+    }
+    std::remove(path.c_str());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * entries));
+}
+BENCHMARK(BM_ParseResponseFile)
+        ->ArgNames({"entries", "quoted"})
+        ->Args({1 << 10, 0})
+        ->Args({1 << 20, 0})
+        ->Args({1 << 20, 1})
+        ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
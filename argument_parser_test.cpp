@@ -1,5 +1,10 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
 #include <vector>
 #include <string>
+#include <thread>
 #include <gtest/gtest.h>
 
 #include "argument_parser.h"
@@ -353,6 +358,41 @@ TEST(ArgumentParser, AddChoiceOption) {
     parser.reset_storage();
 }
 
+TEST(ArgumentParser, AddTypedOption) {
+    ArgumentParser parser;
+    parser.add_option<int>({"-n", "--number"}, "typed", "N", "3");
+    parser.add_option<double>({"--ratio"}, 2, "typed", {"X", "Y"});
+    parser.add_option<unsigned int>({"--unsigned"}, "typed");
+    parser.add_option<bool>({"--switch"}, "typed");
+    parser.add_option<std::string>({"--text"}, "typed");
+    EXPECT_THROW(parser.add_option<int>({"--broken"}, "typed", "N", "x"), UsageException);
+    EXPECT_FALSE(parser.has_option("broken"));
+
+    EXPECT_EQ(3, parser.get<int>("number"));
+    EXPECT_EQ(3L, parser.get<long>("number"));  // other types are converted from the text
+    EXPECT_EQ("3", parser.get<std::string>("number"));
+
+    ASSERT_NO_THROW(parser.parse({"app", "-n=7", "--ratio", "0.5", "2", "--unsigned", "4", "--switch=yes",
+                                  "--text", "abc"}));
+    EXPECT_EQ(7, parser.get<int>("n"));
+    EXPECT_EQ(std::vector<double>({0.5, 2.0}), parser.get_n<double>("ratio"));
+    EXPECT_EQ(4u, parser.get<unsigned int>("unsigned"));
+    EXPECT_TRUE(parser.get<bool>("switch"));
+    EXPECT_EQ("abc", parser.get<std::string>("text"));
+
+    // conversion errors surface while parsing, the option stays unparsed
+    parser.reset_storage();
+    EXPECT_THROW(parser.parse({"app", "--number", "1.5"}), ParsingException);
+    EXPECT_FALSE(parser.is_parsed("number"));
+    EXPECT_EQ(3, parser.get<int>("number"));
+    parser.reset_storage();
+    EXPECT_THROW(parser.parse({"app", "--number", "99999999999"}), ParsingException);
+    parser.reset_storage();
+    EXPECT_THROW(parser.parse({"app", "--switch", "maybe"}), ParsingException);
+    parser.reset_storage();
+    EXPECT_THROW(parser.parse({"app", "--ratio", "1", "x"}), ParsingException);
+}
+
 TEST(ArgumentParser, AddMultiOption) {
     ArgumentParser parser;
     EXPECT_THROW(parser.add_option({""}, 2), UsageException);
@@ -507,6 +547,38 @@ TEST(ArgumentParser, Parse) {
 }
 
 
+TEST(ArgumentParser, ParseManyOptions) {
+    ArgumentParser parser;
+    for (char c = 'a'; c <= 'z'; ++c) {
+        parser.add_flag({std::string("-") + c, std::string("-") + static_cast<char>(c - 'a' + 'A')});
+    }
+    const int number_of_options = 5000;
+    for (int i = 0; i < number_of_options; ++i) {
+        parser.add_option({"--plugin-" + std::to_string(i)}, "plugin option");
+    }
+    EXPECT_THROW(parser.add_flag({"--plugin-42"}), UsageException);
+    EXPECT_THROW(parser.add_flag({"-Q"}), UsageException);
+
+    std::vector<std::string> argv{"app", "-aZq"};
+    for (int i = 0; i < number_of_options; i += 7) {
+        argv.emplace_back("--plugin-" + std::to_string(i) + "=" + std::to_string(i));
+    }
+    ASSERT_NO_THROW(parser.parse(argv));
+    EXPECT_TRUE(parser.is_parsed("A"));
+    EXPECT_TRUE(parser.is_parsed("-z"));
+    EXPECT_TRUE(parser.is_parsed("Q"));
+    EXPECT_FALSE(parser.is_parsed("b"));
+    for (int i = 0; i < number_of_options; ++i) {
+        const auto name = "plugin-" + std::to_string(i);
+        ASSERT_TRUE(parser.has_option(name));
+        ASSERT_EQ(i % 7 == 0, parser.is_parsed(name));
+    }
+    EXPECT_EQ(4998, parser.get<int>("--plugin-4998"));
+    EXPECT_FALSE(parser.has_option("plugin-5000"));
+    EXPECT_THROW(parser.parse({"app", "--plugin-5000"}), ParsingException);
+}
+
+
 TEST(ArgumentParser, ParseMainLikeInput) {
     ArgumentParser parser;
     parser.add_flag({"-f"}, "false");
@@ -534,6 +606,666 @@ TEST(ArgumentParser, ParseMainLikeInput) {
     EXPECT_STREQ("positional", pos[0].c_str());
 }
 
+TEST(ArgumentParser, ParseArgvInPlace) {
+    ArgumentParser parser;
+    parser.add_option({"--long"}, "long");
+    parser.add_option({"-n"}, 2, "two values");
+    parser.set_allowed_positionals(ArgumentParser::unlimited_positionals);
+
+    std::vector<std::string> arg_source{"app", "--long=value", "-n", "1", "2", "--"};
+    for (int i = 0; i < 1000; ++i) {
+        arg_source.emplace_back("positional-" + std::to_string(i));
+    }
+    std::vector<const char*> argv;
+    for (const auto& arg : arg_source) {
+        argv.push_back(arg.c_str());
+    }
+
+    ASSERT_NO_THROW(parser.parse(static_cast<int>(argv.size()), argv.data()));
+    EXPECT_EQ("value", parser.get<std::string>("long"));
+    EXPECT_EQ(std::vector<int>({1, 2}), parser.get_n<int>("n"));
+    const auto& views = parser.get_positional_views();
+    ASSERT_EQ(1000, views.size());
+    EXPECT_EQ(argv[6], views[0].data());  // no copies of the arguments
+    EXPECT_EQ(argv.back(), views.back().data());
+    ASSERT_EQ(1000, parser.get_positionals().size());
+    EXPECT_EQ("positional-999", parser.get_positionals().back());
+}
+
+namespace {
+constexpr utils::option_spec static_specs[] = {
+        {{"-v", "--verbose"}, 0, "verbose output"},
+        {{"-o", "--output"}, 1, "output file", "FILE", "a.out"},
+        {{"--jobs"}, 1, "parallel jobs", "N", "1"},
+        {{"--range"}, 2, "first and last", "X"},
+};
+constexpr auto static_table = utils::make_option_table(static_specs);
+static_assert(static_table.find("verbose") == 0, "names are hashed at compile time");
+static_assert(static_table.find("o") == 1, "short names are part of the table");
+static_assert(static_table.find("range") == 3, "names are hashed at compile time");
+static_assert(static_table.find("missing") == 4, "unknown names map to the number of specs");
+static_assert(utils::check_option_name("--a#") == utils::option_name_error::long_illegal_character,
+              "the naming rules can be checked at compile time");
+}
+
+TEST(ArgumentParser, CompileTimeOptionTable) {
+    ArgumentParser parser(static_table.view());
+    parser.add_option({"--late"}, "added at runtime");
+    EXPECT_THROW(parser.add_flag({"--jobs"}), UsageException);
+    EXPECT_THROW(parser.add_flag({"-v"}), UsageException);
+
+    ASSERT_NO_THROW(parser.parse({"app", "-v", "--jobs=4", "--range", "1", "9", "--late", "x"}));
+    EXPECT_TRUE(parser.get<bool>("verbose"));
+    EXPECT_EQ("a.out", parser.get<std::string>("-o"));
+    EXPECT_EQ(4, parser.get<int>("jobs"));
+    EXPECT_EQ(std::vector<int>({1, 9}), parser.get_n<int>("range"));
+    EXPECT_EQ("x", parser.get<std::string>("late"));
+    EXPECT_NE(std::string::npos, parser.help().find("output file (default: a.out)"));
+    EXPECT_NE(std::string::npos, parser.help().find(" -o --output <FILE>"));
+    EXPECT_NE(std::string::npos, parser.help().find(" --range <X> <X>"));
+
+    // evaluated at runtime the table reports errors by exceptions
+    utils::option_spec duplicate[] = {{{"-a"}, 0}, {{"-b", "-a"}, 0}};
+    EXPECT_THROW(utils::make_option_table(duplicate), UsageException);
+    utils::option_spec illegal[] = {{{"--a#"}, 0}};
+    EXPECT_THROW(utils::make_option_table(illegal), UsageException);
+    utils::option_spec unnamed[] = {{{}, 0}};
+    EXPECT_THROW(utils::make_option_table(unnamed), UsageException);
+}
+
+TEST(ArgumentParser, SharedParserResults) {
+    ArgumentParser parser;
+    parser.add_option<int>({"-n", "--number"}, "a number", "N", "0");
+    parser.add_flag({"-v"}, "verbose");
+    parser.set_allowed_positionals(1);
+    const ArgumentParser& shared = parser;
+
+    std::vector<std::thread> threads;
+    std::vector<int> failures(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&shared, &failures, t]() {
+            utils::parse_result result;
+            for (int i = 0; i < 200; ++i) {
+                const auto number = std::to_string(t * 1000 + i);
+                const char* argv[] = {"app", "--number", number.c_str(), "pos"};
+                shared.parse(4, argv, result);
+                if (result.get<int>("n") != t * 1000 + i || result.get<bool>("v") ||
+                    result.get_positionals() != std::vector<std::string>({"pos"})) {
+                    ++failures[t];
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(std::vector<int>(4, 0), failures);
+
+    utils::parse_result result;
+    ASSERT_NO_THROW(parser.parse({"app", "-v"}, result));
+    EXPECT_TRUE(result.is_parsed("v"));
+    EXPECT_FALSE(result.is_parsed("n"));
+    EXPECT_EQ(0, result.get<int>("number"));
+    EXPECT_EQ("app", result.program_name());
+    EXPECT_FALSE(parser.is_parsed("v"));  // the parser itself holds no results
+
+    // a list that outlives the result is parsed in place instead of copied
+    const ArgumentParser::ArgumentListType arguments{"app", "-n", "3"};
+    ASSERT_NO_THROW(parser.parse(arguments, result));
+    EXPECT_EQ(arguments[0].data(), result.program_name().data());
+    EXPECT_EQ(3, result.get<int>("n"));
+    EXPECT_THROW(utils::parse_result().get<int>("n"), UsageException);
+}
+
+TEST(ArgumentParser, ParseBatch) {
+    ArgumentParser parser;
+    parser.add_option<int>({"-n"}, "a number");
+    parser.set_required({"n"});
+
+    std::vector<ArgumentParser::ArgumentListType> lists;
+    for (int i = 0; i < 1000; ++i) {
+        if (i % 10 == 3) {
+            lists.push_back({"app", "-n", "not a number"});
+        } else if (i % 10 == 7) {
+            lists.push_back({"app"});
+        } else {
+            lists.push_back({"app", "-n", std::to_string(i)});
+        }
+    }
+
+    ArgumentParser::BatchResultList entries;
+    ASSERT_NO_THROW(entries = parser.parse_batch(lists, 4));
+    ASSERT_EQ(lists.size(), entries.size());
+    for (int i = 0; i < 1000; ++i) {
+        if (i % 10 == 3 || i % 10 == 7) {
+            EXPECT_FALSE(entries[i].is_valid());
+        } else {
+            ASSERT_TRUE(entries[i].is_valid()) << entries[i].error;
+            EXPECT_EQ(i, entries[i].result.get<int>("n"));
+        }
+    }
+    EXPECT_NE(std::string::npos, entries[7].error.find("required"));
+
+    lists.resize(10);
+    lists[3] = {"app", "-n", "3"};
+    ASSERT_NO_THROW(parser.parse_batch(lists, entries, 1));
+    ASSERT_EQ(10, entries.size());
+    EXPECT_TRUE(entries[3].is_valid());
+    EXPECT_EQ(3, entries[3].result.get<int>("n"));
+
+    // whatever a callback throws is reported by its entry
+    parser.add_option({"--fail"});
+    parser.set_callback("fail", [](std::string_view) -> bool { throw 42; });
+    lists[5] = {"app", "-n", "5", "--fail", "x"};
+    ASSERT_NO_THROW(parser.parse_batch(lists, entries, 2));
+    EXPECT_FALSE(entries[5].is_valid());
+    EXPECT_TRUE(entries[6].is_valid());
+}
+
+TEST(ArgumentParser, ResponseFiles) {
+    {
+        std::ofstream outer("argument_parser_test_outer.rsp");
+        outer << "--name 'two words'\n-n \"say \\\"hi\\\"\" @argument_parser_test_inner.rsp\n";
+        std::ofstream inner("argument_parser_test_inner.rsp");
+        inner << "  -- plain\\ space\tlast";
+        std::ofstream loop("argument_parser_test_loop.rsp");
+        loop << "@argument_parser_test_loop.rsp";
+    }
+    ArgumentParser parser;
+    parser.add_option({"--name"}, "name");
+    parser.add_option({"-n"}, "value");
+    parser.set_allowed_positionals(ArgumentParser::unlimited_positionals);
+
+    utils::parse_result result;
+    ASSERT_NO_THROW(parser.parse({"app", "@argument_parser_test_outer.rsp"}, result));
+    EXPECT_FALSE(result.is_parsed("name"));  // response files are disabled by default
+    EXPECT_EQ(std::vector<std::string>({"@argument_parser_test_outer.rsp"}), result.get_positionals());
+
+    parser.set_response_files(true, 2);
+    ASSERT_NO_THROW(parser.parse({"app", "@argument_parser_test_outer.rsp", "@not-expanded"}, result));
+    EXPECT_EQ("two words", result.get<std::string>("name"));
+    EXPECT_EQ("say \"hi\"", result.get<std::string>("n"));
+    EXPECT_EQ(std::vector<std::string>({"plain space", "last", "@not-expanded"}), result.get_positionals());
+
+    EXPECT_THROW(parser.parse({"app", "@argument_parser_test_loop.rsp"}, result), ParsingException);
+    EXPECT_THROW(parser.parse({"app", "@argument_parser_test_missing.rsp"}, result), ParsingException);
+    std::remove("argument_parser_test_outer.rsp");
+    std::remove("argument_parser_test_inner.rsp");
+    std::remove("argument_parser_test_loop.rsp");
+}
+
+TEST(ArgumentParser, ParseCommandLine) {
+    ArgumentParser parser;
+    parser.add_option({"--name"}, "name");
+    parser.add_option({"-e"}, "expression");
+    parser.add_flag({"-v"}, "verbose");
+    parser.set_allowed_positionals(ArgumentParser::unlimited_positionals);
+
+    ASSERT_NO_THROW(parser.parse_command_line(std::string("/bin/app -v --name 'single $HOME' -e \"a \\\"b\\\" \\$c \\d\"")));
+    EXPECT_EQ("app", parser.program_name());
+    EXPECT_TRUE(parser.get<bool>("v"));
+    EXPECT_EQ("single $HOME", parser.get<std::string>("name"));
+    EXPECT_EQ("a \"b\" $c \\d", parser.get<std::string>("e"));
+
+    const std::string command_line = "app \\\n  -- plain\\ word ''  *.cpp~ a#b # a comment\n\tlast";
+    utils::parse_result result;
+    ASSERT_NO_THROW(parser.parse_command_line(command_line, result));
+    EXPECT_EQ("app", result.program_name());
+    EXPECT_EQ(std::vector<std::string>({"plain word", "", "*.cpp~", "a#b", "last"}), result.get_positionals());
+    EXPECT_EQ(command_line.data() + command_line.find("*.cpp~"), result.get_positional_views()[2].data());
+
+    EXPECT_THROW(parser.parse_command_line("app 'unterminated", result), ParsingException);
+    EXPECT_THROW(parser.parse_command_line("  # only a comment", result), UsageException);
+}
+
+TEST(ArgumentParser, AbbreviatedOptions) {
+    ArgumentParser parser(static_table.view());
+    parser.add_flag({"--verbosity"}, "verbosity");
+    parser.add_flag({"-q", "--quiet", "--quite"}, "no output");
+    parser.add_option({"--secret"}, "hidden");
+    parser.set_hidden({"secret"});
+
+    utils::parse_result result;
+    ASSERT_NO_THROW(parser.parse({"app", "--jobs=2"}, result));
+    EXPECT_THROW(parser.parse({"app", "--jo=2"}, result), ParsingException);  // exact names by default
+
+    parser.set_abbreviations(true);
+    ASSERT_NO_THROW(parser.parse({"app", "--jo=2", "--verbosi", "--qui", "--out", "file"}, result));
+    EXPECT_EQ(2, result.get<int>("jobs"));
+    EXPECT_FALSE(result.get<bool>("verbose"));
+    EXPECT_TRUE(result.get<bool>("verbosity"));
+    EXPECT_TRUE(result.get<bool>("quiet"));
+    EXPECT_EQ("file", result.get<std::string>("output"));
+    try {
+        parser.parse({"app", "--verb"}, result);
+        FAIL() << "ambiguous prefix accepted";
+    } catch (const ParsingException& e) {
+        EXPECT_STREQ("Option '--verb' is ambiguous, it could be --verbose, --verbosity", e.what());
+    }
+
+    EXPECT_EQ(std::vector<std::string>({"--verbose", "--verbosity"}), parser.complete("--verb"));
+    EXPECT_EQ(std::vector<std::string>({"--quiet", "--quite"}), parser.complete("--qu"));
+    EXPECT_EQ(std::vector<std::string>({"-q"}), parser.complete("-q"));
+    EXPECT_TRUE(parser.complete("--secret").empty());
+    EXPECT_TRUE(parser.complete("--x").empty());
+    EXPECT_TRUE(parser.complete("-x").empty());
+    EXPECT_TRUE(parser.complete("v").empty());
+    EXPECT_TRUE(parser.complete("verbose").empty());
+    EXPECT_EQ(std::vector<std::string>({"-o", "-q", "-v", "--jobs", "--output", "--quiet", "--quite", "--range",
+                                        "--verbose", "--verbosity"}), parser.complete("-"));
+}
+
+namespace {
+enum class Codec { h264 = 4, vp9 = 8, av1 = 16 };
+}
+
+TEST(ArgumentParser, ChoiceIndicesAndEnums) {
+    ArgumentParser parser;
+    parser.add_enum_option<Codec>({"-c", "--codec"}, {{"h264", Codec::h264}, {"vp9", Codec::vp9}, {"av1", Codec::av1}},
+                                  "video codec", "CODEC", "vp9");
+    std::vector<std::string> regions;
+    for (int i = 0; i < 500; ++i) {
+        regions.push_back("region-" + std::to_string(i));
+    }
+    parser.add_option({"--region"}, 1, "region", {}, {}, ArgumentParser::OrderedChoiceStorageType{regions});
+    parser.add_option({"--pair"}, 2, "pair", {}, {}, ArgumentParser::OrderedChoiceStorageType{{"a", "b"}, {"c", "d"}});
+    parser.add_option({"--size"}, 1, "size", {}, {}, {{"s", "m", "l"}});
+    parser.set_appending_arguments({"pair"});
+    EXPECT_THROW(parser.add_enum_option<Codec>({"--twice"}, {{"a", Codec::h264}, {"a", Codec::vp9}}), UsageException);
+
+    EXPECT_EQ(Codec::vp9, parser.get<Codec>("codec"));  // the default
+    EXPECT_EQ(1, parser.get_choice_index("codec"));
+
+    ASSERT_NO_THROW(parser.parse({"app", "--codec=av1", "--region", "region-123", "--pair", "b", "c", "--pair", "a", "d"}));
+    EXPECT_EQ(Codec::av1, parser.get<Codec>("codec"));
+    EXPECT_EQ(2, parser.get_choice_index("c"));
+    EXPECT_EQ("av1", parser.get<std::string>("codec"));
+    EXPECT_THROW(parser.get<int>("codec"), ParsingException);
+    EXPECT_EQ(123, parser.get_choice_index("region"));
+    EXPECT_EQ(std::vector<std::size_t>({1, 0, 0, 1}), parser.get_choice_indices("pair"));
+    EXPECT_THROW(parser.get_choice_index("pair"), UsageException);
+    EXPECT_THROW(parser.get_choice_index("size"), UsageException);  // unordered sets have no indices
+    EXPECT_THROW(parser.get_choice_indices("size"), UsageException);
+
+    utils::parse_result result;
+    EXPECT_THROW(parser.parse({"app", "--codec", "mpeg2"}, result), ParsingException);
+    EXPECT_THROW(parser.parse({"app", "--region", "region-500"}, result), ParsingException);
+    ASSERT_NO_THROW(parser.parse({"app", "-c", "h264"}, result));
+    EXPECT_EQ(Codec::h264, result.get<Codec>("codec"));
+    EXPECT_EQ(std::vector<Codec>({Codec::h264}), result.get_n<Codec>("codec"));
+    EXPECT_THROW(result.get_choice_index("region"), ParsingException);  // neither parsed nor default
+    EXPECT_NE(std::string::npos, parser.help().find("choices: [h264|vp9|av1], default: vp9"));
+}
+
+TEST(ArgumentParser, EnvironmentVariables) {
+    ArgumentParser parser;
+    parser.add_option<int>({"-j", "--jobs"}, "parallel jobs", "N", "1");
+    parser.add_option({"--mode"}, 1, "mode", {}, {}, {{"fast", "safe"}});
+    parser.add_option({"-I"}, "include directory");
+    parser.add_flag({"-v"}, "verbose");
+    parser.add_option({"--token"}, "token");
+    parser.set_appending_arguments({"I"});
+    parser.set_required({"token"});
+    parser.set_environment_variable("jobs", "TEST_APP_JOBS");
+    parser.set_environment_variable("mode", "TEST_APP_MODE");
+    parser.set_environment_variable("I", "TEST_APP_INCLUDE");
+    parser.set_environment_variable("v", "TEST_APP_VERBOSE");
+    parser.set_environment_variable("token", "TEST_APP_TOKEN");
+    EXPECT_THROW(parser.set_environment_variable("v", "TEST_APP_JOBS"), UsageException);
+    EXPECT_THROW(parser.set_environment_variable("v", "A=B"), UsageException);
+    EXPECT_THROW(parser.set_environment_variable("missing", "TEST_APP_MISSING"), UsageException);
+    EXPECT_NE(std::string::npos, parser.help().find("parallel jobs (default: 1, env: TEST_APP_JOBS)"));
+
+    ::unsetenv("TEST_APP_JOBS");
+    ::unsetenv("TEST_APP_MODE");
+    ::unsetenv("TEST_APP_INCLUDE");
+    ::setenv("TEST_APP_VERBOSE", "off", 1);
+    ::setenv("TEST_APP_TOKEN", "secret value", 1);
+    utils::parse_result result;
+    ASSERT_NO_THROW(parser.parse({"app"}, result));
+    EXPECT_EQ(1, result.get<int>("jobs"));  // default
+    EXPECT_FALSE(result.get<bool>("v"));
+    EXPECT_EQ("secret value", result.get<std::string>("token"));  // satisfies required
+
+    ::setenv("TEST_APP_JOBS", "8", 1);
+    ::setenv("TEST_APP_INCLUDE", "a 'b c'", 1);
+    ::setenv("TEST_APP_VERBOSE", "yes", 1);
+    ASSERT_NO_THROW(parser.parse({"app", "--jobs", "2"}, result));
+    ::unsetenv("TEST_APP_TOKEN");
+    EXPECT_EQ(2, result.get<int>("jobs"));  // the command line wins
+    EXPECT_EQ(std::vector<std::string>({"a", "b c"}), result.get_n<std::string>("I"));
+    EXPECT_TRUE(result.get<bool>("v"));
+    EXPECT_EQ("secret value", result.get<std::string>("token"));  // copied while parsing
+    ASSERT_NO_THROW(parser.parse({"app", "--token", "t"}, result));
+    EXPECT_EQ(8, result.get<int>("jobs"));
+
+    ::setenv("TEST_APP_MODE", "slow", 1);
+    EXPECT_THROW(parser.parse({"app", "--token", "t"}, result), ParsingException);
+    ::setenv("TEST_APP_MODE", "safe", 1);
+    ::setenv("TEST_APP_JOBS", "many", 1);
+    EXPECT_THROW(parser.parse({"app", "--token", "t"}, result), ParsingException);
+    ::unsetenv("TEST_APP_JOBS");
+    ::unsetenv("TEST_APP_MODE");
+    ::unsetenv("TEST_APP_INCLUDE");
+    ::unsetenv("TEST_APP_VERBOSE");
+}
+
+TEST(ArgumentParser, Subcommands) {
+    ArgumentParser parser;
+    parser.set_program_info("tool");
+    parser.add_flag({"-v", "--verbose"}, "verbose output");
+    int number_of_builds = 0;
+    parser.add_subcommand("commit", "record changes", [&](ArgumentParser& commit) {
+        ++number_of_builds;
+        commit.add_option({"-m", "--message"}, "commit message", "MSG");
+        commit.add_flag({"-a", "--all"}, "all changes");
+        commit.set_required({"message"});
+        commit.set_allowed_positionals(ArgumentParser::unlimited_positionals);
+    });
+    parser.add_subcommand("status", "show the working tree status", [](ArgumentParser&) {
+        throw std::logic_error("status is never used");
+    });
+    EXPECT_THROW(parser.add_subcommand("commit", "", nullptr), UsageException);
+    EXPECT_THROW(parser.add_subcommand("-x", "", nullptr), UsageException);
+
+    utils::parse_result result;
+    ASSERT_NO_THROW(parser.parse({"tool", "-v"}, result));
+    EXPECT_TRUE(result.get_subcommand().empty());
+    EXPECT_THROW(result.get_subcommand_result(), UsageException);
+    EXPECT_EQ(0, number_of_builds);
+
+    ASSERT_NO_THROW(parser.parse({"tool", "commit", "-a", "-m", "fix", "--verbose", "file.cpp"}, result));
+    EXPECT_EQ("commit", result.get_subcommand());
+    EXPECT_TRUE(result.get<bool>("verbose"));  // a global option after the subcommand
+    const auto& commit = result.get_subcommand_result();
+    EXPECT_EQ("fix", commit.get<std::string>("message"));
+    EXPECT_TRUE(commit.get<bool>("all"));
+    EXPECT_EQ(std::vector<std::string>({"file.cpp"}), commit.get_positionals());
+    EXPECT_THROW(result.get<std::string>("message"), ParsingException);
+
+    EXPECT_THROW(parser.parse({"tool", "commit"}, result), ParsingException);  // required by the subcommand
+    EXPECT_THROW(parser.parse({"tool", "push"}, result), ParsingException);
+    EXPECT_THROW(parser.parse({"tool", "-m", "x", "commit"}, result), ParsingException);
+    ASSERT_NO_THROW(parser.parse({"tool", "-v", "commit", "-m", "again"}));
+    EXPECT_EQ("again", parser.get_subcommand_result().get<std::string>("m"));
+    EXPECT_EQ(1, number_of_builds);
+
+    // the parent's options follow its own rules, arguments after "--" are no subcommands
+    parser.set_abbreviations(true);
+    ASSERT_NO_THROW(parser.parse({"tool", "commit", "-m", "x", "--verb"}, result));
+    EXPECT_TRUE(result.get<bool>("verbose"));
+    EXPECT_EQ("x", result.get_subcommand_result().get<std::string>("message"));
+    EXPECT_EQ(utils::parse_error::too_many_positionals, parser.try_parse({"tool", "--", "commit"}, result).code());
+    EXPECT_TRUE(result.get_subcommand().empty());
+    parser.set_abbreviations(false);
+
+    const auto help = parser.help();
+    EXPECT_NE(std::string::npos, help.find("  tool [OPTION...] <SUBCOMMAND> [ARGUMENTS...]\n"));
+    EXPECT_NE(std::string::npos, help.find("Subcommands:\n commit  record changes\n status  show the working tree status\n"));
+    const auto commit_help = parser.help("commit");
+    EXPECT_EQ(0u, commit_help.find("Usage of tool commit:"));
+    EXPECT_NE(std::string::npos, commit_help.find("commit message"));
+    EXPECT_THROW(parser.help("status"), std::logic_error);
+    EXPECT_THROW(parser.help("push"), UsageException);
+}
+
+TEST(ArgumentParser, TryParse) {
+    ArgumentParser parser;
+    parser.add_option<int>({"--jobs"}, "parallel jobs");
+    parser.add_option({"--mode"}, 1, "mode", {}, {}, {{"debug", "release"}});
+    parser.add_option({"--name"}, "name");
+    parser.add_flag({"-v", "--verbose"}, "verbose");
+    parser.add_flag({"-q", "--quiet"}, "quiet");
+    parser.set_required({"name"});
+    parser.add_xor({"verbose", "quiet"});
+
+    utils::parse_result result;
+    auto status = parser.try_parse({"app", "--name", "x", "--jobs", "4"}, result);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(utils::parse_error::none, status.code());
+    EXPECT_EQ(4, result.get<int>("jobs"));
+
+    status = parser.try_parse({"app", "--name", "x", "--jobs", "four"}, result);
+    ASSERT_FALSE(status);
+    EXPECT_EQ(utils::parse_error::invalid_value, status.code());
+    EXPECT_EQ(3u, status.argument_index());
+    EXPECT_EQ("jobs", status.option());
+    EXPECT_EQ("four", status.errors()[0].argument);
+    EXPECT_EQ("Argument ‘four’ failed to parse", status.message());
+    EXPECT_FALSE(result.is_parsed("jobs"));  // rolled back
+
+    // the first error only, as parse() throws it
+    status = parser.try_parse({"app", "--unknown", "-vq", "--mode", "fast"}, result);
+    ASSERT_EQ(1u, status.errors().size());
+    EXPECT_EQ(utils::parse_error::unknown_option, status.code());
+    EXPECT_EQ("unknown", status.option());
+    const auto message = status.message();  // the views of the status refer to the result
+    EXPECT_EQ("Option 'unknown' does not exist.", message);
+    try {
+        parser.parse({"app", "--unknown", "-vq", "--mode", "fast"}, result);
+        FAIL() << "unknown option accepted";
+    } catch (const ParsingException& e) {
+        EXPECT_EQ(message, e.what());
+    }
+
+    // or all of them in one pass
+    status = parser.try_parse({"app", "--unknown", "-vq", "--mode", "fast", "-v"}, result, true);
+    std::vector<utils::parse_error> codes;
+    std::vector<std::size_t> indices;
+    for (const auto& error : status.errors()) {
+        codes.push_back(error.code);
+        indices.push_back(error.argument_index);
+    }
+    EXPECT_EQ(std::vector<utils::parse_error>({utils::parse_error::unknown_option, utils::parse_error::invalid_choice,
+                                                utils::parse_error::repeated_option,
+                                                utils::parse_error::missing_required,
+                                                utils::parse_error::mutually_exclusive}), codes);
+    EXPECT_EQ(std::vector<std::size_t>({1, 3, 5, ArgumentParser::ParseError::npos, ArgumentParser::ParseError::npos}),
+              indices);
+    EXPECT_EQ("'fast' does not match possible choices for mode", status.errors()[1].message());
+    EXPECT_EQ("The following arguments are required, but were not set: name, ", status.errors()[3].message());
+    EXPECT_TRUE(result.is_parsed("verbose"));
+
+    status = parser.try_parse_command_line("app --name 'x", result);
+    EXPECT_EQ(utils::parse_error::missing_quote, status.code());
+    EXPECT_EQ(2u, status.argument_index());
+    EXPECT_EQ("Missing closing quote ' in ''x'", status.message());
+    EXPECT_EQ(utils::parse_error::no_arguments, parser.try_parse(0, nullptr, result).code());
+    EXPECT_THROW(parser.parse(0, nullptr, result), UsageException);
+}
+
+TEST(ArgumentParser, BoundOptions) {
+    ArgumentParser parser;
+    parser.add_option<int>({"-j", "--jobs"}, "parallel jobs", "N", "1");
+    parser.add_option({"-I", "--include"}, "include directory", "DIR");
+    parser.add_option({"--size"}, 2, "width and height");
+    parser.add_option({"--mode"}, 1, "mode", {}, {}, {{"debug", "release"}});
+    parser.add_flag({"-v", "--verbose"}, "verbose");
+    parser.set_appending_arguments({"include"});
+
+    int jobs = 0;
+    bool verbose = true;
+    std::vector<std::string> includes;
+    std::vector<double> size;
+    std::vector<std::string> modes;
+    parser.bind("jobs", jobs);
+    parser.bind("verbose", verbose);
+    parser.bind("include", includes);
+    parser.bind("size", size);
+    parser.set_callback("mode", [&modes](std::string_view mode) {
+        modes.emplace_back(mode);
+        return true;
+    });
+
+    utils::parse_result result;
+    ASSERT_NO_THROW(parser.parse({"app", "-I", "a", "--include=b", "--size", "1.5", "2", "-I", "c"}, result));
+    EXPECT_EQ(1, jobs);  // the default
+    EXPECT_FALSE(verbose);
+    EXPECT_EQ(std::vector<std::string>({"a", "b", "c"}), includes);
+    EXPECT_EQ(std::vector<double>({1.5, 2}), size);
+    EXPECT_TRUE(modes.empty());
+    EXPECT_TRUE(result.is_parsed("include"));
+    EXPECT_FALSE(result.is_parsed("jobs"));
+    EXPECT_THROW(result.get_n<std::string>("include"), UsageException);
+
+    ASSERT_NO_THROW(parser.parse({"app", "-v", "-j", "8", "--mode", "release"}, result));
+    EXPECT_EQ(8, jobs);
+    EXPECT_TRUE(verbose);
+    EXPECT_EQ(std::vector<std::string>({"release"}), modes);
+
+    EXPECT_THROW(parser.parse({"app", "--jobs", "many"}, result), ParsingException);
+    EXPECT_THROW(parser.parse({"app", "--mode", "fast"}, result), ParsingException);
+    EXPECT_THROW(parser.parse({"app", "-v", "-v"}, result), ParsingException);
+    EXPECT_EQ(std::vector<std::string>({"release"}), modes);
+
+    // typed values are validated before the callback sees them, refusing flags fail as well
+    ArgumentParser typed;
+    std::vector<std::string> seen;
+    typed.add_option<int>({"--count"}, "count");
+    typed.add_flag({"--refused"}, "refused flag");
+    typed.set_callback("count", [&seen](std::string_view value) {
+        seen.emplace_back(value);
+        return true;
+    });
+    typed.set_callback("refused", [](std::string_view value) { return value != "true"; });
+    auto status = typed.try_parse({"app", "--count", "abc"}, result);
+    EXPECT_EQ(utils::parse_error::invalid_value, status.code());
+    EXPECT_TRUE(seen.empty());
+    status = typed.try_parse({"app", "--refused"}, result);
+    EXPECT_EQ(utils::parse_error::invalid_value, status.code());
+    EXPECT_EQ("refused", status.option());
+    EXPECT_TRUE(typed.try_parse({"app", "--count", "3"}, result).ok());
+    EXPECT_EQ(std::vector<std::string>({"3"}), seen);
+}
+
+TEST(ArgumentParser, PositionalCallback) {
+    ArgumentParser parser;
+    parser.add_flag({"-v", "--verbose"}, "verbose");
+    parser.set_allowed_positionals(3);
+    parser.set_required_positionals(2);
+    std::vector<std::string> files;
+    parser.set_positional_callback([&files](std::string_view file) {
+        if (file == "missing") {
+            return false;
+        }
+        files.emplace_back(file);
+        return true;
+    });
+
+    utils::parse_result result;
+    ASSERT_NO_THROW(parser.parse({"app", "-v", "a", "b", "c"}, result));
+    EXPECT_EQ(std::vector<std::string>({"a", "b", "c"}), files);
+    EXPECT_TRUE(result.has_positionals());
+    EXPECT_EQ(3u, result.number_of_positionals());
+    EXPECT_TRUE(result.get_positional_views().empty());  // not stored
+
+    files.clear();
+    auto status = parser.try_parse({"app", "--", "-a", "b", "c", "d"}, result);
+    EXPECT_EQ(utils::parse_error::too_many_positionals, status.code());
+    EXPECT_EQ(5u, status.argument_index());
+    EXPECT_EQ(std::vector<std::string>({"-a", "b", "c"}), files);
+
+    EXPECT_EQ(utils::parse_error::too_few_positionals, parser.try_parse({"app", "a"}, result).code());
+    EXPECT_EQ(utils::parse_error::option_after_positional, parser.try_parse({"app", "a", "-v"}, result).code());
+    status = parser.try_parse({"app", "a", "missing"}, result);
+    EXPECT_EQ(utils::parse_error::invalid_value, status.code());
+    EXPECT_EQ("missing", status.errors()[0].argument);
+}
+
+TEST(ArgumentParser, Constraints) {
+    ArgumentParser parser;
+    parser.add_option({"--user"}, "user");
+    parser.add_option({"--password"}, "password");
+    parser.add_option({"--width"}, "width");
+    parser.add_option({"--height"}, "height");
+    parser.add_flag({"--json"}, "json output");
+    parser.add_flag({"--xml"}, "xml output");
+    for (int i = 0; i < 200; ++i) {  // constraints over several words of the bitset
+        parser.add_flag({"--flag-" + std::to_string(i)});
+    }
+    parser.add_requires("password", {"user"});
+    parser.add_inclusive({"width", "height"});
+    parser.add_at_least_one({"json", "xml", "flag-150"});
+    parser.add_xor({"flag-10", "flag-130"});
+    parser.set_required({"flag-70", "flag-199"});
+    EXPECT_THROW(parser.add_requires("missing", {"user"}), UsageException);
+    EXPECT_THROW(parser.add_inclusive({"width"}), UsageException);
+    EXPECT_THROW(parser.add_at_least_one({}), UsageException);
+
+    utils::parse_result result;
+    const std::vector<std::string> required{"--flag-70", "--flag-199"};
+    auto with_required = [&](std::vector<std::string> arguments) {
+        arguments.insert(arguments.begin() + 1, required.begin(), required.end());
+        return arguments;
+    };
+    EXPECT_TRUE(parser.try_parse(with_required({"app", "--json"}), result));
+    EXPECT_TRUE(parser.try_parse(with_required({"app", "--flag-150", "--user", "u", "--password", "p"}), result));
+    EXPECT_TRUE(parser.try_parse(with_required({"app", "--xml", "--width", "1", "--height", "2"}), result));
+
+    auto status = parser.try_parse(with_required({"app", "--json", "--password", "p"}), result);
+    EXPECT_EQ(utils::parse_error::missing_dependency, status.code());
+    EXPECT_EQ("Option 'password' requires 'user'.", status.message());
+
+    status = parser.try_parse(with_required({"app", "--json", "--height", "2"}), result);
+    EXPECT_EQ(utils::parse_error::incomplete_group, status.code());
+    EXPECT_EQ("Option 'height' has to be used together with 'width'.", status.message());
+
+    status = parser.try_parse(with_required({"app"}), result);
+    EXPECT_EQ(utils::parse_error::missing_one_of, status.code());
+    EXPECT_EQ("At least one of the options 'json', 'xml', 'flag-150' is required.", status.message());
+
+    status = parser.try_parse(with_required({"app", "--xml", "--flag-130", "--flag-10"}), result);
+    EXPECT_EQ(utils::parse_error::mutually_exclusive, status.code());
+    EXPECT_EQ("Option 'flag-10' and 'flag-130' must not be used together.", status.message());
+
+    status = parser.try_parse({"app", "--json"}, result);
+    EXPECT_EQ("The following arguments are required, but were not set: flag-70, flag-199, ", status.message());
+
+    // all violated rules in one pass
+    status = parser.try_parse({"app", "--flag-70", "--password", "p", "--width", "1"}, result, true);
+    std::vector<utils::parse_error> codes;
+    for (const auto& error : status.errors()) {
+        codes.push_back(error.code);
+    }
+    EXPECT_EQ(std::vector<utils::parse_error>({utils::parse_error::missing_required,
+                                                utils::parse_error::missing_dependency,
+                                                utils::parse_error::incomplete_group,
+                                                utils::parse_error::missing_one_of}), codes);
+}
+
+TEST(ArgumentParser, KeepsResultsUntilReset) {
+    ArgumentParser parser;
+    parser.add_flag({"-a"});
+    parser.add_option({"--name"});
+    const char* first[] = {"app", "--name", "first"};
+    const char* second[] = {"app", "-a"};
+    const std::vector<std::function<void(const char**, int)>> overloads{
+            [&parser](const char** argv, int argc) { parser.parse(argc, argv); },
+            [&parser](const char** argv, int argc) {
+                parser.parse(ArgumentParser::ArgumentListType(argv, argv + argc));
+            },
+            [&parser](const char** argv, int argc) {
+                std::string command_line;
+                for (int i = 0; i < argc; ++i) {
+                    command_line += std::string(argv[i]) + " ";
+                }
+                parser.parse_command_line(command_line);
+            }};
+
+    for (const auto& parse : overloads) {
+        ASSERT_NO_THROW(parse(first, 3));
+        ASSERT_NO_THROW(parse(second, 2));
+        EXPECT_EQ("first", parser.get<std::string>("name"));
+        EXPECT_TRUE(parser.get<bool>("a"));
+        EXPECT_THROW(parse(second, 2), utils::ParsingException);
+
+        parser.reset_storage();
+        ASSERT_NO_THROW(parse(second, 2));
+        EXPECT_FALSE(parser.is_parsed("name"));
+        parser.reset_storage();
+    }
+}
+
 TEST(ArgumentParser, GenerateHelp) {
     ArgumentParser parser;
     parser.set_program_info("app", "1.0");
@@ -574,3 +1306,38 @@ TEST(ArgumentParser, GenerateHelp) {
     auto help = parser.help();
     EXPECT_STREQ(expected_help.c_str(), help.c_str());
 }
+
+TEST(ArgumentParser, WrappedHelp) {
+    ArgumentParser parser;
+    parser.set_program_info("app");
+    parser.add_flag({"-v"}, "verbose");
+    parser.add_option({"--jobs"}, "number of jobs that are run in parallel", "N", "1");
+    parser.set_help_width(40);
+
+    std::string expected_help =
+    "Usage of app:\n"
+    "  app [OPTION...]\n"
+    "\n"
+    "Options:\n"
+    " -v          verbose\n"
+    " --jobs <N>  number of jobs that are run\n"
+    "             in parallel (default: 1)\n";
+    EXPECT_EQ(expected_help, parser.help());
+
+    // the cached help is rendered again after changes
+    parser.add_flag({"--a-very-long-flag-name"}, "flag");
+    parser.set_help_width(0);
+    expected_help =
+    "Usage of app:\n"
+    "  app [OPTION...]\n"
+    "\n"
+    "Options:\n"
+    " -v                       verbose\n"
+    " --jobs <N>               number of jobs that are run in parallel (default: 1)\n"
+    " --a-very-long-flag-name  flag\n";
+    EXPECT_EQ(expected_help, parser.help());
+
+    // too narrow to wrap next to the names
+    parser.set_help_width(30);
+    EXPECT_EQ(expected_help, parser.help());
+}
@@ -1,8 +1,19 @@
 #include "config_parser.h"
+#include "config_parser_scan.h"
 
-#include <regex>
 #include <algorithm>
 
+namespace {
+bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+void throw_line_error(std::size_t line_number, const char *begin, const char *end) {
+    std::string msg = "Failed to parse line " + std::to_string(line_number) + ": '" + std::string(begin, end) + "'";
+    throw config_parser::ConfigParserException(msg.c_str());
+}
+}
+
 void config_parser::ConfigParser::parse_file(const std::string &filename) {
     std::ifstream file(filename);
     if (file.bad()) {
@@ -15,8 +26,12 @@ void config_parser::ConfigParser::parse_file(const std::string &filename) {
 }
 
 void config_parser::ConfigParser::parse_string(const std::string &content) {
+    parse_buffer(content.data(), content.size());
+}
+
+void config_parser::ConfigParser::parse_buffer(const char *data, std::size_t size) {
     std::stringstream input_stream(std::ios::in | std::ios::out);
-    input_stream.str(content);
+    input_stream.str(std::string(data, size));
     parse(input_stream);
 }
 
@@ -36,32 +51,37 @@ const std::string config_parser::ConfigParser::write_string() const {
     return out.str();
 }
 
-std::vector<config_parser::IniParser::KeyType> config_parser::IniParser::sections() const {
-    std::vector<KeyType> keys;
+namespace config_parser {
+
+template<typename Allocator>
+std::vector<typename BasicIniParser<Allocator>::NameType> BasicIniParser<Allocator>::sections() const {
+    std::vector<NameType> keys;
     keys.reserve(m_map.size());
     for (const auto &kv : m_map) {
-        keys.push_back(kv.first);
+        keys.push_back(to_name(kv.first));
     }
     return keys;
 }
 
-std::vector<config_parser::IniParser::KeyType>
-config_parser::IniParser::options(const config_parser::IniParser::KeyType &section) const {
+template<typename Allocator>
+std::vector<typename BasicIniParser<Allocator>::NameType>
+BasicIniParser<Allocator>::options(const NameType &section) const {
     auto section_iter = m_map.find(normalize_key(section));
     if (section_iter == m_map.end()) {
         std::string msg = "Section ‘" + section + "’ not present";
         throw ConfigParserException(msg.c_str());
     }
-    std::vector<KeyType> options;
+    std::vector<NameType> options;
     options.reserve(section_iter->second.size());
     for (const auto &okv : section_iter->second) {
-        options.push_back(okv.first);
+        options.push_back(to_name(okv.first));
     }
     return options;
 }
 
-const std::unordered_map<config_parser::IniParser::KeyType, config_parser::IniParser::ValueType> &
-config_parser::IniParser::items(const config_parser::IniParser::KeyType &section) const {
+template<typename Allocator>
+const typename BasicIniParser<Allocator>::SectionType &
+BasicIniParser<Allocator>::items(const NameType &section) const {
     auto section_iter = m_map.find(normalize_key(section));
     if (section_iter == m_map.end()) {
         std::string msg = "Section ‘" + section + "’ not present";
@@ -70,13 +90,14 @@ config_parser::IniParser::items(const config_parser::IniParser::KeyType &section
     return section_iter->second;
 }
 
-bool config_parser::IniParser::has(const config_parser::IniParser::KeyType &section) const {
+template<typename Allocator>
+bool BasicIniParser<Allocator>::has(const NameType &section) const {
     auto section_iter = m_map.find(normalize_key(section));
     return (section_iter != m_map.end());
 }
 
-bool config_parser::IniParser::has(const config_parser::IniParser::KeyType &section,
-                                       const config_parser::IniParser::KeyType &option) const {
+template<typename Allocator>
+bool BasicIniParser<Allocator>::has(const NameType &section, const NameType &option) const {
     auto section_iter = m_map.find(normalize_key(section));
     if (section_iter == m_map.end())
         return false;
@@ -84,17 +105,58 @@ bool config_parser::IniParser::has(const config_parser::IniParser::KeyType &sect
     return (option_iter != section_iter->second.end());
 }
 
-void config_parser::IniParser::remove(const config_parser::IniParser::KeyType &section) {
+template<typename Allocator>
+void BasicIniParser<Allocator>::set(const NameType &section, const NameType &option, const std::string &value) {
+    const auto allocator = get_allocator();
+    auto section_key = normalize_key(section, allocator);
+    auto option_key = normalize_key(option, allocator);
+    ChangeList changes;
+    {
+#ifdef CONFIG_PARSER_STATS
+        StatisticsRecorder::ScopedTimer timer(m_statistics, StatisticsRecorder::Phase::insertion);
+        m_statistics.register_option(to_name(section_key), to_name(option_key));
+#endif
+        if (m_subscriptions.empty()) {
+            m_map[std::move(section_key)][std::move(option_key)].assign(value.data(), value.size());
+            return;
+        }
+
+        auto &options = m_map[section_key];
+        auto option_iter = options.find(option_key);
+        if (option_iter == options.end()) {
+            options[option_key].assign(value.data(), value.size());
+            changes.push_back({Change::Kind::added, to_name(section_key), to_name(option_key)});
+        } else if (std::string_view(option_iter->second) != value) {
+            option_iter->second.assign(value.data(), value.size());
+            changes.push_back({Change::Kind::modified, to_name(section_key), to_name(option_key)});
+        }
+    }
+    if (!changes.empty()) {
+        notify(changes);
+    }
+}
+
+template<typename Allocator>
+void BasicIniParser<Allocator>::remove(const NameType &section) {
     auto section_iter = m_map.find(normalize_key(section));
     if (section_iter == m_map.end()) {
         std::string msg = "Section ‘" + section + "’ not present";
         throw ConfigParserException(msg.c_str());
     }
+    ChangeList changes;
+    if (!m_subscriptions.empty()) {
+        for (const auto &option : section_iter->second) {
+            changes.push_back({Change::Kind::removed, to_name(section_iter->first), to_name(option.first)});
+        }
+    }
     m_map.erase(section_iter);
+    if (!changes.empty()) {
+        notify(changes);
+    }
 }
 
-void config_parser::IniParser::remove(const config_parser::IniParser::KeyType &section,
-                                          const config_parser::IniParser::KeyType &option) {
+template<typename Allocator>
+void BasicIniParser<Allocator>::remove(const NameType &section, const NameType &option) {
     auto section_iter = m_map.find(normalize_key(section));
     if (section_iter == m_map.end()) {
         std::string msg = "Section ‘" + section + "’ not present";
@@ -105,40 +167,249 @@ void config_parser::IniParser::remove(const config_parser::IniParser::KeyType &s
         std::string msg = "Option ‘" + option + "’ not present";
         throw ConfigParserException(msg.c_str());
     }
+    if (m_subscriptions.empty()) {
+        section_iter->second.erase(option_iter);
+        return;
+    }
+    ChangeList changes{{Change::Kind::removed, to_name(section_iter->first), to_name(option_iter->first)}};
     section_iter->second.erase(option_iter);
+    notify(changes);
 }
 
-void config_parser::IniParser::parse(std::istream &in) {
-    static const std::regex empty_regex{R"x(\s*)x"};
-    static const std::regex comment_regex{R"x(\s*[;#])x"};
-    static const std::regex section_regex{R"x(\s*\[([^\]]+)\])x"};
-    static const std::regex value_regex{R"x(\s*(\S[^ \t=]*)\s*=\s*((\s?\S+)+)\s*$)x"};
+template<typename Allocator>
+typename BasicIniParser<Allocator>::SubscriptionId
+BasicIniParser<Allocator>::subscribe(const NameType &section, ChangeCallback callback) {
+    return add_subscription(section, {0, Subscription::Scope::section, NameType(), std::move(callback)});
+}
 
-    std::string current_section;
-    std::smatch match;
-    std::size_t line_number = 0;
-    for (std::string line; std::getline(in, line);) {
-        ++line_number;
-        if (line.empty()
-            || std::regex_match(line, match, empty_regex)
-            || std::regex_match(line, match, comment_regex)) {
+template<typename Allocator>
+typename BasicIniParser<Allocator>::SubscriptionId
+BasicIniParser<Allocator>::subscribe(const NameType &section, const NameType &option, ChangeCallback callback) {
+    return add_subscription(section,
+                            {0, Subscription::Scope::option, to_name(normalize_key(option)), std::move(callback)});
+}
+
+template<typename Allocator>
+typename BasicIniParser<Allocator>::SubscriptionId
+BasicIniParser<Allocator>::subscribe_prefix(const NameType &section, const NameType &option_prefix,
+                                            ChangeCallback callback) {
+    return add_subscription(section, {0, Subscription::Scope::prefix, to_name(normalize_key(option_prefix)),
+                                      std::move(callback)});
+}
+
+template<typename Allocator>
+void BasicIniParser<Allocator>::unsubscribe(SubscriptionId id) {
+    for (auto section_iter = m_subscriptions.begin(); section_iter != m_subscriptions.end(); ++section_iter) {
+        auto &subscriptions = section_iter->second;
+        auto iter = std::find_if(subscriptions.begin(), subscriptions.end(),
+                                 [id](const Subscription &s) { return s.id == id; });
+        if (iter != subscriptions.end()) {
+            subscriptions.erase(iter);
+            if (subscriptions.empty()) {
+                m_subscriptions.erase(section_iter);
+            }
+            return;
+        }
+    }
+    throw ConfigParserException("Subscription not present");
+}
+
+template<typename Allocator>
+typename BasicIniParser<Allocator>::SubscriptionId
+BasicIniParser<Allocator>::add_subscription(const NameType &section, Subscription subscription) {
+    if (!subscription.callback) {
+        throw ConfigParserException("No callback given for subscription");
+    }
+    subscription.id = ++m_last_subscription_id;
+    m_subscriptions[to_name(normalize_key(section))].push_back(std::move(subscription));
+    return m_last_subscription_id;
+}
+
+template<typename Allocator>
+bool BasicIniParser<Allocator>::Subscription::matches(const NameType &changed) const {
+    switch (scope) {
+        case Scope::section:
+            return true;
+        case Scope::option:
+            return changed == option;
+        case Scope::prefix:
+            return changed.compare(0, option.size(), option) == 0;
+    }
+    return false;
+}
+
+template<typename Allocator>
+void BasicIniParser<Allocator>::notify(const ChangeList &changes) const {
+    // collect first, callbacks may subscribe or unsubscribe
+    std::vector<std::pair<ChangeCallback, ChangeList>> pending;
+    std::unordered_map<SubscriptionId, std::size_t> pending_index;
+    for (const auto &change : changes) {
+        auto section_iter = m_subscriptions.find(change.section);
+        if (section_iter == m_subscriptions.end()) {
             continue;
-        } else if (std::regex_match(line, match, section_regex)) {
-            if (match.size() == 2) { // exactly one match
-                current_section = match[1].str();
+        }
+        for (const auto &subscription : section_iter->second) {
+            if (!subscription.matches(change.option)) {
+                continue;
+            }
+            auto index_iter = pending_index.find(subscription.id);
+            if (index_iter == pending_index.end()) {
+                index_iter = pending_index.emplace(subscription.id, pending.size()).first;
+                pending.emplace_back(subscription.callback, ChangeList());
             }
-        } else if (std::regex_match(line, match, value_regex)) {
-            if (match.size() == 4) { // exactly enough matches
-                m_map[current_section][match[1].str()] = match[2].str();
+            pending[index_iter->second].second.push_back(change);
+        }
+    }
+    for (const auto &callback_changes : pending) {
+        callback_changes.first(callback_changes.second);
+    }
+}
+
+template<typename Allocator>
+void BasicIniParser<Allocator>::notify(const OriginalValueMap &originals) const {
+    if (originals.empty()) {
+        return;
+    }
+    ChangeList changes;
+    for (const auto &section_originals : originals) {
+        const auto &options = m_map.at(normalize_key(section_originals.first));
+        for (const auto &original : section_originals.second) {
+            if (!original.second.existed) {
+                changes.push_back({Change::Kind::added, section_originals.first, original.first});
+            } else if (original.second.value != std::string_view(options.at(normalize_key(original.first)))) {
+                changes.push_back({Change::Kind::modified, section_originals.first, original.first});
             }
-        } else {
-            std::string msg = "Failed to parse line " + std::to_string(line_number) + ": '" + line + "'";
-            throw ConfigParserException(msg.c_str());
         }
     }
+    notify(changes);
 }
 
-void config_parser::IniParser::write(std::ostream &os) const {
+template<typename Allocator>
+void BasicIniParser<Allocator>::parse(std::istream &in) {
+    std::string content;
+    char buffer[1 << 16];
+    while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
+        content.append(buffer, static_cast<std::size_t>(in.gcount()));
+    }
+    parse_buffer(content.data(), content.size());
+}
+
+template<typename Allocator>
+void BasicIniParser<Allocator>::parse_buffer(const char *data, std::size_t size) {
+    static const std::size_t none = std::string::npos;
+#ifdef CONFIG_PARSER_STATS
+    const auto parse_start = StatisticsRecorder::Clock::now();
+    StatisticsRecorder::Clock::duration insertion_time{};
+#endif
+    const auto allocator = get_allocator();
+    StructuralScanner scanner(data, size);
+    KeyType current_section(allocator);
+    SectionType *current_options = nullptr;  // created on the first option of a section
+    std::size_t line_number = 0;
+    std::size_t line_begin = 0;
+    std::size_t first_structural = none;
+    std::size_t assignment = none;
+    OriginalValueMap originals;
+    try {
+        for (auto position = scanner.next();; position = scanner.next()) {
+            if (position != size && data[position] != '\n') {
+                if (first_structural == none) {
+                    first_structural = position;
+                }
+                if (assignment == none && data[position] == '=') {
+                    assignment = position;
+                }
+                continue;
+            }
+            if (position == size && line_begin == size) {
+                break;
+            }
+
+            ++line_number;
+            auto begin = line_begin;
+            auto end = position;
+            while (begin < end && is_blank(data[begin])) {
+                ++begin;
+            }
+            while (end > begin && is_blank(data[end - 1])) {
+                --end;
+            }
+
+            if (begin == end) {
+                // empty line
+            } else if (begin == first_structural && (data[begin] == ';' || data[begin] == '#')) {
+                // comment
+            } else if (begin == first_structural && data[begin] == '[') {
+                if ((end - begin < 3) || (data[end - 1] != ']') ||
+                    std::find(data + begin + 1, data + end - 1, ']') != data + end - 1) {
+                    throw_line_error(line_number, data + line_begin, data + position);
+                }
+                current_section = normalize_key(std::string_view(data + begin + 1, end - begin - 2), allocator);
+                current_options = nullptr;
+            } else if (assignment != none && assignment < end) {
+                auto key_end = assignment;
+                while (key_end > begin && is_blank(data[key_end - 1])) {
+                    --key_end;
+                }
+                auto value_begin = assignment + 1;
+                while (value_begin < end && is_blank(data[value_begin])) {
+                    ++value_begin;
+                }
+                if ((key_end == begin) || (value_begin == end) ||
+                    std::find_if(data + begin, data + key_end, is_blank) != data + key_end) {
+                    throw_line_error(line_number, data + line_begin, data + position);
+                }
+#ifdef CONFIG_PARSER_STATS
+                const auto insertion_start = StatisticsRecorder::Clock::now();
+#endif
+                auto option = normalize_key(std::string_view(data + begin, key_end - begin), allocator);
+#ifdef CONFIG_PARSER_STATS
+                m_statistics.register_option(to_name(current_section), to_name(option));
+#endif
+                if (current_options == nullptr) {
+                    current_options = &m_map[current_section];
+                }
+                if (!m_subscriptions.empty() && m_subscriptions.count(to_name(current_section)) != 0) {
+                    auto &section_originals = originals[to_name(current_section)];
+                    if (section_originals.find(to_name(option)) == section_originals.end()) {
+                        auto existing = current_options->find(option);
+                        if (existing == current_options->end()) {
+                            section_originals.emplace(to_name(option), OriginalValue{false, std::string()});
+                        } else {
+                            section_originals.emplace(to_name(option), OriginalValue{true, to_name(existing->second)});
+                        }
+                    }
+                }
+                (*current_options)[std::move(option)].assign(data + value_begin, data + end);
+#ifdef CONFIG_PARSER_STATS
+                insertion_time += StatisticsRecorder::Clock::now() - insertion_start;
+#endif
+            } else {
+                throw_line_error(line_number, data + line_begin, data + position);
+            }
+
+            if (position == size) {
+                break;
+            }
+            line_begin = position + 1;
+            first_structural = none;
+            assignment = none;
+        }
+    } catch (...) {
+        notify(originals);  // lines before the failing one have been applied
+        throw;
+    }
+    notify(originals);
+#ifdef CONFIG_PARSER_STATS
+    m_statistics.add_lines(line_number);
+    m_statistics.add_time(StatisticsRecorder::Phase::insertion, insertion_time);
+    m_statistics.add_time(StatisticsRecorder::Phase::lexing,
+                          StatisticsRecorder::Clock::now() - parse_start - insertion_time);
+#endif
+}
+
+template<typename Allocator>
+void BasicIniParser<Allocator>::write(std::ostream &os) const {
     for (const auto &section : m_map) {
         os << "[" << section.first << "]" << std::endl;
         for (const auto &option: section.second) {
@@ -148,13 +419,40 @@ void config_parser::IniParser::write(std::ostream &os) const {
     }
 }
 
-std::string config_parser::IniParser::normalize_key(config_parser::IniParser::KeyType key) const {
+template<typename Allocator>
+Statistics BasicIniParser<Allocator>::statistics() const {
+    Statistics stats;
+#ifdef CONFIG_PARSER_STATS
+    m_statistics.fill(stats);
+#endif
+    stats.sections = m_map.size();
+    stats.section_load_factor = m_map.load_factor();
+    for (const auto &section : m_map) {
+        stats.key_bytes += section.first.size();
+        stats.options += section.second.size();
+        stats.option_load_factor += section.second.load_factor();
+        for (const auto &option : section.second) {
+            stats.key_bytes += option.first.size();
+            stats.value_bytes += option.second.size();
+        }
+    }
+    if (!m_map.empty()) {
+        stats.option_load_factor /= static_cast<float>(m_map.size());
+    }
+    return stats;
+}
+
+template<typename Allocator>
+typename BasicIniParser<Allocator>::KeyType
+BasicIniParser<Allocator>::normalize_key(std::string_view name, const Allocator &allocator) const {
+    KeyType key(name.begin(), name.end(), allocator);
     std::transform(key.begin(), key.end(), key.begin(), ::tolower);
     return key;
 }
 
-void config_parser::IniParser::parse_value(const config_parser::IniParser::ValueType &text, bool &value) const {
-    auto value_str(text);
+template<typename Allocator>
+void BasicIniParser<Allocator>::parse_value(const ValueType &text, bool &value) const {
+    std::string value_str(text.data(), text.size());
     // Convert to lower case to make string comparisons case-insensitive
     std::transform(value_str.begin(), value_str.end(), value_str.begin(), ::tolower);
     if (value_str == "true" || value_str == "yes" || value_str == "on" || value_str == "1")
@@ -162,12 +460,17 @@ void config_parser::IniParser::parse_value(const config_parser::IniParser::Value
     else if (value_str == "false" || value_str == "no" || value_str == "off" || value_str == "0")
         value = false;
     else {
-        std::string msg = "Value ‘" + text + "’ failed to parse as boolean";
+        std::string msg = "Value ‘" + to_name(text) + "’ failed to parse as boolean";
         throw ConfigParserException(msg.c_str());
     }
 }
 
-void
-config_parser::IniParser::parse_value(const config_parser::IniParser::ValueType &text, std::string &value) const {
-    value = text;
+template<typename Allocator>
+void BasicIniParser<Allocator>::parse_value(const ValueType &text, std::string &value) const {
+    value.assign(text.data(), text.size());
+}
+
+template class BasicIniParser<std::allocator<char>>;
+
+template class BasicIniParser<std::pmr::polymorphic_allocator<char>>;
 }
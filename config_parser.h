@@ -6,6 +6,12 @@
 #include <fstream>
 #include <sstream>
 #include <exception>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+
+#include "config_parser_stats.h"
 
 namespace config_parser {
 
@@ -34,6 +40,8 @@ public:
 
     virtual void parse(std::istream &in) = 0;
 
+    virtual void parse_buffer(const char *data, std::size_t size);
+
     void write_file(const std::string &filename) const;;
 
     const std::string write_string() const;
@@ -41,39 +49,75 @@ public:
     virtual void write(std::ostream &os) const = 0;
 };
 
-class IniParser : public ConfigParser {
+// INI parser whose keys, values and hash nodes come from `Allocator`. Names passed in and
+// handed out are plain std::string, so all instantiations share one interface.
+template<typename Allocator = std::allocator<char>>
+class BasicIniParser : public ConfigParser {
+    template<typename T>
+    using Rebind = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+
 public:
-    using KeyType = std::string;
-    using ValueType = std::string;
-    using SectionType = std::unordered_map<KeyType, ValueType>;
+    using allocator_type = Allocator;
+    using NameType = std::string;
+    using KeyType = std::basic_string<char, std::char_traits<char>, Allocator>;
+    using ValueType = KeyType;
+    using SectionType = std::unordered_map<KeyType, ValueType, std::hash<KeyType>, std::equal_to<KeyType>,
+            Rebind<std::pair<const KeyType, ValueType>>>;
+
+    struct Change {
+        enum class Kind { added, modified, removed };
+
+        Kind kind;
+        NameType section;
+        NameType option;
+    };
+    using ChangeList = std::vector<Change>;
+    using ChangeCallback = std::function<void(const ChangeList &)>;
+    using SubscriptionId = std::size_t;
+
+    BasicIniParser() : BasicIniParser(Allocator()) {}
+
+    explicit BasicIniParser(const Allocator &allocator) : m_map(MapAllocator(allocator)) {}
+
+    ~BasicIniParser() = default;
+
+    explicit BasicIniParser(std::istream &stream, const Allocator &allocator = Allocator())
+            : BasicIniParser(allocator) { parse(stream); }
 
-    IniParser() = default;
+    explicit BasicIniParser(const std::string &filename, const Allocator &allocator = Allocator())
+            : BasicIniParser(allocator) { parse_file(filename); }
 
-    ~IniParser() = default;
+    Allocator get_allocator() const { return Allocator(m_map.get_allocator()); }
 
-    explicit IniParser(std::istream &stream) { parse(stream); }
 
-    explicit IniParser(const std::string &filename) { parse_file(filename); }
+    std::vector<NameType> sections() const;
 
+    std::vector<NameType> options(const NameType &section) const;
 
-    std::vector<KeyType> sections() const;
+    const SectionType &items(const NameType &section) const;
 
-    std::vector<KeyType> options(const KeyType &section) const;
 
-    const std::unordered_map<KeyType, ValueType> &items(const KeyType &section) const;
+    bool has(const NameType &section) const;
 
+    bool has(const NameType &section, const NameType &option) const;
 
-    bool has(const KeyType &section) const;
+    void remove(const NameType &section);
 
-    bool has(const KeyType &section, const KeyType &option) const;
+    void remove(const NameType &section, const NameType &option);
 
-    void remove(const KeyType &section);
+    // Callbacks are invoked after set(), remove() or parse() with all changes that match the
+    // subscription, coalesced per call. Setting an option to its current value is no change.
+    SubscriptionId subscribe(const NameType &section, ChangeCallback callback);
 
-    void remove(const KeyType &section, const KeyType &option);
+    SubscriptionId subscribe(const NameType &section, const NameType &option, ChangeCallback callback);
+
+    SubscriptionId subscribe_prefix(const NameType &section, const NameType &option_prefix, ChangeCallback callback);
+
+    void unsubscribe(SubscriptionId id);
 
     template<typename T>
-    void set(const KeyType &section,
-             const KeyType &option,
+    void set(const NameType &section,
+             const NameType &option,
              const T &value) {
         static_assert(std::is_fundamental<T>::value ||
                       std::is_same<T, std::string>::value, "Use fundamental type to get option");
@@ -83,78 +127,157 @@ public:
         set(section, option, os.str());
     }
 
-    void set(const KeyType &section,
-             const KeyType &option,
+    void set(const NameType &section,
+             const NameType &option,
              const bool &value) {
-        set(section, option, ValueType(value ? "true" : "false"));
+        set(section, option, std::string(value ? "true" : "false"));
     }
 
-    void set(const KeyType &section,
-             const KeyType &option,
+    void set(const NameType &section,
+             const NameType &option,
              const char *value) {
-        m_map[normalize_key(section)][normalize_key(option)] = std::string(value);
+        set(section, option, std::string(value));
     }
 
-    void set(const KeyType &section,
-             const KeyType &option,
-             const ValueType &value) {
-        m_map[normalize_key(section)][normalize_key(option)] = value;
-    }
+    void set(const NameType &section,
+             const NameType &option,
+             const std::string &value);
 
     template<typename T>
-    const T get(const KeyType &section,
-                const KeyType &option) const {
+    const T get(const NameType &section,
+                const NameType &option) const {
         static_assert(std::is_fundamental<T>::value ||
                       std::is_same<T, std::string>::value, "Use fundamental type to get option");
 
-        auto section_iter = m_map.find(normalize_key(section));
+        const auto section_key = normalize_key(section);
+        const auto option_key = normalize_key(option);
+        auto section_iter = m_map.find(section_key);
         if (section_iter == m_map.end()) {
+            record_miss(section_key, option_key);
             std::string msg = "Section ‘" + section + "’ not present";
             throw ConfigParserException(msg.c_str());
         }
-        auto option_iter = section_iter->second.find(normalize_key(option));
+        auto option_iter = section_iter->second.find(option_key);
         if (option_iter == section_iter->second.end()) {
+            record_miss(section_key, option_key);
             std::string msg = "Option ‘" + option + "’ not present";
             throw ConfigParserException(msg.c_str());
         }
         T store;
-        parse_value(option_iter->second, store);
+        convert_value(section_iter->first, option_iter->first, option_iter->second, store);
         return store;
     }
 
     template<typename T>
-    const T get(const KeyType &section,
-                const KeyType &option,
+    const T get(const NameType &section,
+                const NameType &option,
                 const T &default_value) const {
         static_assert(std::is_fundamental<T>::value ||
                       std::is_same<T, std::string>::value, "Use fundamental type to get option");
 
-        auto section_iter = m_map.find(normalize_key(section));
-        if (section_iter == m_map.end())
+        const auto section_key = normalize_key(section);
+        const auto option_key = normalize_key(option);
+        auto section_iter = m_map.find(section_key);
+        if (section_iter == m_map.end()) {
+            record_miss(section_key, option_key);
             return default_value;
-        auto option_iter = section_iter->second.find(normalize_key(option));
-        if (option_iter == section_iter->second.end())
+        }
+        auto option_iter = section_iter->second.find(option_key);
+        if (option_iter == section_iter->second.end()) {
+            record_miss(section_key, option_key);
             return default_value;
+        }
 
         T store;
-        parse_value(option_iter->second, store);
+        convert_value(section_iter->first, option_iter->first, option_iter->second, store);
         return store;
     }
 
     void parse(std::istream &in) final;
 
+    void parse_buffer(const char *data, std::size_t size) final;
+
     void write(std::ostream &os) const final;
 
+    // snapshot of timings, storage and lookup counters, see CONFIG_PARSER_STATS
+    Statistics statistics() const;
+
 private:
-    std::unordered_map<KeyType, SectionType> m_map;
+    using MapAllocator = Rebind<std::pair<const KeyType, SectionType>>;
+    using MapType = std::unordered_map<KeyType, SectionType, std::hash<KeyType>, std::equal_to<KeyType>, MapAllocator>;
+
+    struct Subscription {
+        enum class Scope { section, option, prefix };
 
-    std::string normalize_key(KeyType key) const;
+        bool matches(const NameType &option) const;
+
+        SubscriptionId id;
+        Scope scope;
+        NameType option;
+        ChangeCallback callback;
+    };
+
+    // value of a touched option before the current parse, to coalesce repeated writes
+    struct OriginalValue {
+        bool existed;
+        std::string value;
+    };
+    using OriginalValueMap = std::unordered_map<NameType, std::unordered_map<NameType, OriginalValue>>;
+
+    MapType m_map;
+    std::unordered_map<NameType, std::vector<Subscription>> m_subscriptions;
+    SubscriptionId m_last_subscription_id{0};
+#ifdef CONFIG_PARSER_STATS
+    StatisticsRecorder m_statistics;
+#endif
+
+    // lookup keys are temporaries and use a default constructed allocator, stored keys get the
+    // allocator of the parser
+    KeyType normalize_key(std::string_view name, const Allocator &allocator = Allocator()) const;
+
+    static const std::string &to_name(const std::string &key) { return key; }
+
+    template<typename Key>
+    static std::string to_name(const Key &key) { return std::string(key.data(), key.size()); }
+
+    SubscriptionId add_subscription(const NameType &section, Subscription subscription);
+
+    void notify(const ChangeList &changes) const;
+
+    void notify(const OriginalValueMap &originals) const;
+
+    void record_miss(const KeyType &section, const KeyType &option) const {
+#ifdef CONFIG_PARSER_STATS
+        m_statistics.record_miss(to_name(section), to_name(option));
+#else
+        (void) section;
+        (void) option;
+#endif
+    }
+
+    template<typename T>
+    void convert_value(const KeyType &section, const KeyType &option, const ValueType &text, T &value) const {
+#ifdef CONFIG_PARSER_STATS
+        auto counters = m_statistics.record_get(to_name(section), to_name(option));
+        StatisticsRecorder::ScopedTimer timer(m_statistics, counters);
+        try {
+            parse_value(text, value);
+        } catch (const ConfigParserException &) {
+            StatisticsRecorder::record_conversion_failure(counters);
+            throw;
+        }
+#else
+        (void) section;
+        (void) option;
+        parse_value(text, value);
+#endif
+    }
 
     template<typename T>
     void parse_value(const ValueType &text, T &value) const {
-        std::istringstream is(text);
+        std::istringstream is(to_name(text));
         if (!(is >> value) || (is.rdbuf()->in_avail() != 0)) {
-            std::string msg = "Value ‘" + text + "’ failed to parse";
+            std::string msg = "Value ‘" + to_name(text) + "’ failed to parse";
             throw ConfigParserException(msg.c_str());
         }
     }
@@ -164,4 +287,14 @@ private:
     void parse_value(const ValueType &text, std::string &value) const;
 
 };
+
+extern template class BasicIniParser<std::allocator<char>>;
+
+extern template class BasicIniParser<std::pmr::polymorphic_allocator<char>>;
+
+using IniParser = BasicIniParser<>;
+
+// takes a std::pmr::memory_resource, e.g. a monotonic arena for configurations that are built
+// once, which then releases the memory of the whole configuration at once
+using PmrIniParser = BasicIniParser<std::pmr::polymorphic_allocator<char>>;
 }
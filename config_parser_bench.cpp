@@ -0,0 +1,362 @@
+#include <cstdio>
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "config_parser.h"
+#include "config_parser_scan.h"
+
+using ConfigParser = config_parser::IniParser;
+using Scanner = config_parser::StructuralScanner;
+
+namespace {
+enum class ValueKind { string = 0, integer, floating, boolean };
+
+// shape of a synthetic configuration, taken from the benchmark arguments
+struct IniShape {
+    explicit IniShape(const benchmark::State& state)
+            : IniShape(state, static_cast<ValueKind>(state.range(3))) {}
+
+    IniShape(const benchmark::State& state, ValueKind value_kind)
+            : options(static_cast<std::size_t>(state.range(0))),
+              sections(static_cast<std::size_t>(state.range(1))),
+              key_length(static_cast<std::size_t>(state.range(2))),
+              kind(value_kind) {}
+
+    std::size_t options;
+    std::size_t sections;
+    std::size_t key_length;
+    ValueKind kind;
+};
+
+std::string make_section(std::size_t index) {
+    return "section_" + std::to_string(index);
+}
+
+std::string make_key(std::size_t index, std::size_t length) {
+    auto key = "k" + std::to_string(index);
+    if (key.size() < length) {
+        key.append(length - key.size(), 'x');
+    }
+    return key;
+}
+
+std::string make_value(ValueKind kind, std::size_t index) {
+    switch (kind) {
+        case ValueKind::integer:
+            return std::to_string(index * 7919);
+        case ValueKind::floating:
+            return std::to_string(static_cast<double>(index) * 0.25);
+        case ValueKind::boolean:
+            return (index % 2 == 0) ? "true" : "off";
+        default:
+            return "value number " + std::to_string(index);
+    }
+}
+
+std::string generate_ini(const IniShape& shape) {
+    std::string text;
+    const auto per_section = (shape.options + shape.sections - 1) / shape.sections;
+    for (std::size_t i = 0; i < shape.options; ++i) {
+        if (i % per_section == 0) {
+            text += "[" + make_section(i / per_section) + "]\n";
+        }
+        text += make_key(i, shape.key_length) + " = " + make_value(shape.kind, i) + "\n";
+    }
+    return text;
+}
+
+// INI text of roughly `bytes` size with 64 options per section
+std::string generate_ini(std::size_t bytes, std::size_t value_length) {
+    std::string text;
+    text.reserve(bytes + 256);
+    const std::string value(value_length, 'v');
+    for (std::size_t i = 0; text.size() < bytes; ++i) {
+        if (i % 64 == 0) {
+            text += "[" + make_section(i / 64) + "]\n";
+        }
+        text += "key_" + std::to_string(i) + " = " + value + "\n";
+    }
+    return text;
+}
+
+// (section, option) pairs in the order the generator wrote them
+std::vector<std::pair<std::string, std::string>> generate_keys(const IniShape& shape) {
+    std::vector<std::pair<std::string, std::string>> keys;
+    keys.reserve(shape.options);
+    const auto per_section = (shape.options + shape.sections - 1) / shape.sections;
+    for (std::size_t i = 0; i < shape.options; ++i) {
+        keys.emplace_back(make_section(i / per_section), make_key(i, shape.key_length));
+    }
+    return keys;
+}
+
+template<typename T>
+ValueKind kind_of();
+
+template<>
+ValueKind kind_of<std::string>() { return ValueKind::string; }
+
+template<>
+ValueKind kind_of<int>() { return ValueKind::integer; }
+
+template<>
+ValueKind kind_of<double>() { return ValueKind::floating; }
+
+template<>
+ValueKind kind_of<bool>() { return ValueKind::boolean; }
+
+// options, sections, key length, value kind
+void shapes(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"options", "sections", "key_length", "kind"});
+    for (auto options : {64, 4096, 65536}) {
+        for (auto sections : {1, 64}) {
+            for (auto key_length : {8, 32}) {
+                for (auto kind : {ValueKind::string, ValueKind::integer, ValueKind::floating, ValueKind::boolean}) {
+                    bench->Args({options, sections, key_length, static_cast<int>(kind)});
+                }
+            }
+        }
+    }
+}
+
+// options, sections, key length; the value kind follows the accessed type
+void typed_shapes(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"options", "sections", "key_length"});
+    for (auto options : {64, 65536}) {
+        for (auto sections : {1, 64}) {
+            for (auto key_length : {8, 32}) {
+                bench->Args({options, sections, key_length});
+            }
+        }
+    }
+}
+}
+
+static void BM_ScanStructurals(benchmark::State& state) {
+    const auto kernel = static_cast<Scanner::Kernel>(state.range(0));
+    if (!Scanner::is_supported(kernel)) {
+        state.SkipWithError("kernel not supported by this CPU");
+        return;
+    }
+    const auto text = generate_ini(16 << 20, 32);
+    for (auto _ : state) {
+        Scanner scanner(text.data(), text.size(), kernel);
+        std::size_t structurals = 0;
+        while (scanner.next() != text.size()) {
+            ++structurals;
+        }
+        benchmark::DoNotOptimize(structurals);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+BENCHMARK(BM_ScanStructurals)
+        ->ArgName("kernel")
+        ->Arg(static_cast<int>(Scanner::Kernel::scalar))
+        ->Arg(static_cast<int>(Scanner::Kernel::sse2))
+        ->Arg(static_cast<int>(Scanner::Kernel::avx2));
+
+static void BM_ParseThroughput(benchmark::State& state) {
+    const auto text = generate_ini(static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+    for (auto _ : state) {
+        ConfigParser cfg;
+        cfg.parse_string(text);
+        benchmark::DoNotOptimize(cfg);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+BENCHMARK(BM_ParseThroughput)
+        ->ArgNames({"bytes", "value_length"})
+        ->Args({1 << 20, 16})
+        ->Args({16 << 20, 16})
+        ->Args({16 << 20, 256})
+        ->Args({16 << 20, 4096})
+        ->Unit(benchmark::kMillisecond);
+
+static void BM_ParseString(benchmark::State& state) {
+    const IniShape shape(state);
+    const auto text = generate_ini(shape);
+    for (auto _ : state) {
+        ConfigParser cfg;
+        cfg.parse_string(text);
+        benchmark::DoNotOptimize(cfg);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * shape.options));
+}
+BENCHMARK(BM_ParseString)->Apply(shapes);
+
+static void BM_ParseStringArena(benchmark::State& state) {
+    const IniShape shape(state);
+    const auto text = generate_ini(shape);
+    std::vector<char> buffer(text.size() * 4 + (1 << 20));
+    for (auto _ : state) {
+        std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+        {
+            config_parser::PmrIniParser cfg(&arena);
+            cfg.parse_string(text);
+            benchmark::DoNotOptimize(cfg);
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * shape.options));
+}
+BENCHMARK(BM_ParseStringArena)->Apply(shapes);
+
+static void BM_ParseFile(benchmark::State& state) {
+    const IniShape shape(state);
+    const auto text = generate_ini(shape);
+    const std::string filename = "config_parser_bench_parse.ini";
+    {
+        std::ofstream file(filename);
+        file << text;
+    }
+    for (auto _ : state) {
+        ConfigParser cfg;
+        cfg.parse_file(filename);
+        benchmark::DoNotOptimize(cfg);
+    }
+    std::remove(filename.c_str());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * shape.options));
+}
+BENCHMARK(BM_ParseFile)->Apply(shapes);
+
+template<typename T>
+static void BM_GetHit(benchmark::State& state) {
+    const IniShape shape(state, kind_of<T>());
+    ConfigParser cfg;
+    cfg.parse_string(generate_ini(shape));
+    const auto keys = generate_keys(shape);
+    std::size_t next = 0;
+    for (auto _ : state) {
+        const auto& key = keys[next];
+        benchmark::DoNotOptimize(cfg.get<T>(key.first, key.second));
+        next = (next + 1 == keys.size()) ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK_TEMPLATE(BM_GetHit, std::string)->Apply(typed_shapes);
+BENCHMARK_TEMPLATE(BM_GetHit, int)->Apply(typed_shapes);
+BENCHMARK_TEMPLATE(BM_GetHit, double)->Apply(typed_shapes);
+BENCHMARK_TEMPLATE(BM_GetHit, bool)->Apply(typed_shapes);
+
+// missing option in an existing section, answered with the default value
+template<typename T>
+static void BM_GetMissDefault(benchmark::State& state) {
+    const IniShape shape(state, kind_of<T>());
+    ConfigParser cfg;
+    cfg.parse_string(generate_ini(shape));
+    auto keys = generate_keys(shape);
+    for (auto& key : keys) {
+        key.second += "_missing";
+    }
+    const T default_value{};
+    std::size_t next = 0;
+    for (auto _ : state) {
+        const auto& key = keys[next];
+        benchmark::DoNotOptimize(cfg.get<T>(key.first, key.second, default_value));
+        next = (next + 1 == keys.size()) ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK_TEMPLATE(BM_GetMissDefault, std::string)->Apply(typed_shapes);
+BENCHMARK_TEMPLATE(BM_GetMissDefault, int)->Apply(typed_shapes);
+
+// missing option without default, reported by an exception
+template<typename T>
+static void BM_GetMissThrowing(benchmark::State& state) {
+    const IniShape shape(state, kind_of<T>());
+    ConfigParser cfg;
+    cfg.parse_string(generate_ini(shape));
+    auto keys = generate_keys(shape);
+    for (auto& key : keys) {
+        key.second += "_missing";
+    }
+    std::size_t next = 0;
+    for (auto _ : state) {
+        const auto& key = keys[next];
+        try {
+            benchmark::DoNotOptimize(cfg.get<T>(key.first, key.second));
+        } catch (const config_parser::ConfigParserException& e) {
+            benchmark::DoNotOptimize(e);
+        }
+        next = (next + 1 == keys.size()) ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK_TEMPLATE(BM_GetMissThrowing, int)->Apply(typed_shapes);
+
+// overwrite existing options with values of the getter type
+template<typename T>
+static void BM_SetExisting(benchmark::State& state) {
+    const IniShape shape(state, kind_of<T>());
+    ConfigParser cfg;
+    cfg.parse_string(generate_ini(shape));
+    const auto keys = generate_keys(shape);
+    const auto value = cfg.get<T>(keys.front().first, keys.front().second);
+    std::size_t next = 0;
+    for (auto _ : state) {
+        const auto& key = keys[next];
+        cfg.set(key.first, key.second, value);
+        next = (next + 1 == keys.size()) ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK_TEMPLATE(BM_SetExisting, std::string)->Apply(typed_shapes);
+BENCHMARK_TEMPLATE(BM_SetExisting, int)->Apply(typed_shapes);
+BENCHMARK_TEMPLATE(BM_SetExisting, double)->Apply(typed_shapes);
+BENCHMARK_TEMPLATE(BM_SetExisting, bool)->Apply(typed_shapes);
+
+// fill an empty parser with all options of the shape
+static void BM_SetNew(benchmark::State& state) {
+    const IniShape shape(state);
+    const auto keys = generate_keys(shape);
+    std::vector<std::string> values;
+    values.reserve(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        values.push_back(make_value(shape.kind, i));
+    }
+    for (auto _ : state) {
+        ConfigParser cfg;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            cfg.set(keys[i].first, keys[i].second, values[i]);
+        }
+        benchmark::DoNotOptimize(cfg);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * keys.size()));
+}
+BENCHMARK(BM_SetNew)->Apply(shapes);
+
+static void BM_WriteString(benchmark::State& state) {
+    const IniShape shape(state);
+    ConfigParser cfg;
+    cfg.parse_string(generate_ini(shape));
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        const auto text = cfg.write_string();
+        bytes = text.size();
+        benchmark::DoNotOptimize(text);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * shape.options));
+}
+BENCHMARK(BM_WriteString)->Apply(shapes);
+
+static void BM_WriteFile(benchmark::State& state) {
+    const IniShape shape(state);
+    ConfigParser cfg;
+    const auto text = generate_ini(shape);
+    cfg.parse_string(text);
+    const std::string filename = "config_parser_bench_write.ini";
+    for (auto _ : state) {
+        cfg.write_file(filename);
+    }
+    std::remove(filename.c_str());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * shape.options));
+}
+BENCHMARK(BM_WriteFile)->Apply(shapes);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,129 @@
+#include "config_parser_scan.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CONFIG_PARSER_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+inline bool is_structural(char c) {
+    return c == '\n' || c == '=' || c == '[' || c == ';' || c == '#';
+}
+
+void classify_scalar(const char *data, std::size_t blocks, std::uint64_t *masks) {
+    for (std::size_t block = 0; block < blocks; ++block) {
+        const char *bytes = data + block * 64;
+        std::uint64_t mask = 0;
+        for (unsigned i = 0; i < 64; ++i) {
+            mask |= static_cast<std::uint64_t>(is_structural(bytes[i])) << i;
+        }
+        masks[block] = mask;
+    }
+}
+
+#ifdef CONFIG_PARSER_SCAN_X86
+inline std::uint64_t classify_sse2_16(const char *bytes) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes));
+    __m128i hits = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('=')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('[')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(';')));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('#')));
+    return static_cast<std::uint16_t>(_mm_movemask_epi8(hits));
+}
+
+__attribute__((target("sse2")))
+void classify_sse2(const char *data, std::size_t blocks, std::uint64_t *masks) {
+    for (std::size_t block = 0; block < blocks; ++block) {
+        const char *bytes = data + block * 64;
+        masks[block] = classify_sse2_16(bytes) |
+                       (classify_sse2_16(bytes + 16) << 16) |
+                       (classify_sse2_16(bytes + 32) << 32) |
+                       (classify_sse2_16(bytes + 48) << 48);
+    }
+}
+
+__attribute__((target("avx2")))
+inline std::uint64_t classify_avx2_32(const char *bytes) {
+    const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes));
+    __m256i hits = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('=')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('[')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(';')));
+    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('#')));
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(hits));
+}
+
+__attribute__((target("avx2")))
+void classify_avx2(const char *data, std::size_t blocks, std::uint64_t *masks) {
+    for (std::size_t block = 0; block < blocks; ++block) {
+        const char *bytes = data + block * 64;
+        masks[block] = classify_avx2_32(bytes) | (classify_avx2_32(bytes + 32) << 32);
+    }
+}
+#endif
+}
+
+const std::size_t config_parser::StructuralScanner::batch_blocks;
+
+config_parser::StructuralScanner::Kernel config_parser::StructuralScanner::best_kernel() {
+    static const Kernel kernel = is_supported(Kernel::avx2) ? Kernel::avx2
+                                                            : (is_supported(Kernel::sse2) ? Kernel::sse2
+                                                                                          : Kernel::scalar);
+    return kernel;
+}
+
+bool config_parser::StructuralScanner::is_supported(config_parser::StructuralScanner::Kernel kernel) {
+    switch (kernel) {
+        case Kernel::scalar:
+            return true;
+#ifdef CONFIG_PARSER_SCAN_X86
+        case Kernel::sse2:
+            return __builtin_cpu_supports("sse2");
+        case Kernel::avx2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+config_parser::StructuralScanner::StructuralScanner(const char *data, std::size_t size,
+                                                    config_parser::StructuralScanner::Kernel kernel)
+        : m_data(data), m_size(size), m_classify(classify_scalar) {
+#ifdef CONFIG_PARSER_SCAN_X86
+    if (kernel == Kernel::avx2 && is_supported(Kernel::avx2)) {
+        m_classify = classify_avx2;
+    } else if (kernel != Kernel::scalar && is_supported(Kernel::sse2)) {
+        m_classify = classify_sse2;
+    }
+#else
+    (void) kernel;
+#endif
+}
+
+bool config_parser::StructuralScanner::refill() {
+    m_batch_offset += m_batch_blocks * 64;
+    m_block = 0;
+    if (m_batch_offset >= m_size) {
+        m_batch_blocks = 0;
+        return false;
+    }
+
+    const auto remaining = m_size - m_batch_offset;
+    if (remaining >= 64) {
+        m_batch_blocks = std::min(remaining / 64, batch_blocks);
+        m_classify(m_data + m_batch_offset, m_batch_blocks, m_masks);
+    } else {
+        // pad the tail with blanks, so the kernels only ever see full blocks
+        char tail[64];
+        std::memset(tail, ' ', sizeof(tail));
+        std::memcpy(tail, m_data + m_batch_offset, remaining);
+        m_batch_blocks = 1;
+        m_classify(tail, 1, m_masks);
+    }
+    return true;
+}
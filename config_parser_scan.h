@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace config_parser {
+
+// Classifies the structural characters of INI text ('\n', '=', '[', ';' and '#') 64 bytes
+// at a time and hands out their offsets in increasing order.
+class StructuralScanner {
+public:
+    enum class Kernel { scalar, sse2, avx2 };
+
+    // fastest kernel supported by the running CPU
+    static Kernel best_kernel();
+
+    static bool is_supported(Kernel kernel);
+
+    StructuralScanner(const char *data, std::size_t size, Kernel kernel = best_kernel());
+
+    StructuralScanner(const StructuralScanner &) = delete;
+
+    // offset of the next structural character, size() once all have been returned
+    std::size_t next() {
+        while (m_current == 0) {
+            if (++m_block >= m_batch_blocks && !refill()) {
+                return m_size;
+            }
+            m_current = m_masks[m_block];
+        }
+        const auto bit = count_trailing_zeros(m_current);
+        m_current &= m_current - 1;
+        return m_batch_offset + m_block * 64 + bit;
+    }
+
+    inline std::size_t size() const { return m_size; }
+
+private:
+    using ClassifyFunction = void (*)(const char *data, std::size_t blocks, std::uint64_t *masks);
+
+    static const std::size_t batch_blocks = 64;
+
+    static unsigned count_trailing_zeros(std::uint64_t mask) {
+#if defined(__GNUC__)
+        return static_cast<unsigned>(__builtin_ctzll(mask));
+#else
+        unsigned count = 0;
+        while ((mask & 1u) == 0) {
+            mask >>= 1;
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    bool refill();
+
+    const char *m_data;
+    std::size_t m_size;
+    ClassifyFunction m_classify;
+    std::size_t m_batch_offset{0};
+    std::size_t m_batch_blocks{0};
+    std::size_t m_block{0};
+    std::uint64_t m_current{0};
+    std::uint64_t m_masks[batch_blocks];
+};
+}
@@ -0,0 +1,211 @@
+#include "config_parser_stats.h"
+
+#include <cstdio>
+#include <sstream>
+
+namespace {
+std::string json_escape(const std::string &text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (const auto c : text) {
+        switch (c) {
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            case '\t':
+                escaped += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    escaped += buffer;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+}
+
+std::string config_parser::Statistics::to_text() const {
+    std::ostringstream os;
+    os << "statistics: " << (enabled ? "enabled" : "disabled") << "\n";
+    os << "lexing: " << lexing_ns << " ns\n";
+    os << "conversion: " << conversion_ns << " ns\n";
+    os << "insertion: " << insertion_ns << " ns\n";
+    os << "lines: " << lines << "\n";
+    os << "sections: " << sections << "\n";
+    os << "options: " << options << "\n";
+    os << "key bytes: " << key_bytes << "\n";
+    os << "value bytes: " << value_bytes << "\n";
+    os << "section load factor: " << section_load_factor << "\n";
+    os << "option load factor: " << option_load_factor << "\n";
+    os << "gets: " << gets << "\n";
+    os << "misses: " << misses << "\n";
+    os << "conversion failures: " << conversion_failures << "\n";
+    for (const auto &option : per_option) {
+        os << "[" << option.section << "] " << option.option << ": gets=" << option.gets
+           << " misses=" << option.misses << " conversion_failures=" << option.conversion_failures << "\n";
+    }
+    return os.str();
+}
+
+std::string config_parser::Statistics::to_json() const {
+    std::ostringstream os;
+    os << "{\"enabled\":" << (enabled ? "true" : "false")
+       << ",\"lexing_ns\":" << lexing_ns
+       << ",\"conversion_ns\":" << conversion_ns
+       << ",\"insertion_ns\":" << insertion_ns
+       << ",\"lines\":" << lines
+       << ",\"sections\":" << sections
+       << ",\"options\":" << options
+       << ",\"key_bytes\":" << key_bytes
+       << ",\"value_bytes\":" << value_bytes
+       << ",\"section_load_factor\":" << section_load_factor
+       << ",\"option_load_factor\":" << option_load_factor
+       << ",\"gets\":" << gets
+       << ",\"misses\":" << misses
+       << ",\"conversion_failures\":" << conversion_failures
+       << ",\"per_option\":[";
+    for (std::size_t i = 0; i < per_option.size(); ++i) {
+        const auto &option = per_option[i];
+        if (i != 0) {
+            os << ",";
+        }
+        os << "{\"section\":\"" << json_escape(option.section)
+           << "\",\"option\":\"" << json_escape(option.option)
+           << "\",\"gets\":" << option.gets
+           << ",\"misses\":" << option.misses
+           << ",\"conversion_failures\":" << option.conversion_failures << "}";
+    }
+    os << "]}";
+    return os.str();
+}
+
+#ifdef CONFIG_PARSER_STATS
+using recorder = config_parser::StatisticsRecorder;
+
+recorder::Counters::Counters(const recorder::Counters &other) noexcept
+        : gets(other.gets.load(std::memory_order_relaxed)),
+          conversion_failures(other.conversion_failures.load(std::memory_order_relaxed)),
+          conversion_ns(other.conversion_ns.load(std::memory_order_relaxed)) {}
+
+recorder::MissCounter::MissCounter(const recorder::MissCounter &other) noexcept
+        : count(other.count.load(std::memory_order_relaxed)) {}
+
+recorder::StatisticsRecorder(const recorder &other) {
+    *this = other;
+}
+
+recorder &recorder::operator=(const recorder &other) {
+    if (this == &other) {
+        return *this;
+    }
+    for (int i = 0; i < 3; ++i) {
+        m_time_ns[i].value.store(other.m_time_ns[i].value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    m_lines.store(other.m_lines.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_counters = other.m_counters;
+    MissMap misses;
+    {
+        std::shared_lock<std::shared_mutex> lock(other.m_miss_mutex);
+        misses = other.m_misses;
+    }
+    std::unique_lock<std::shared_mutex> lock(m_miss_mutex);
+    m_misses = std::move(misses);
+    return *this;
+}
+
+void recorder::register_option(const std::string &section, const std::string &option) {
+    m_counters[section][option];
+}
+
+recorder::Counters *recorder::record_get(const std::string &section, const std::string &option) const {
+    auto section_iter = m_counters.find(section);
+    if (section_iter == m_counters.end()) {
+        return nullptr;
+    }
+    auto option_iter = section_iter->second.find(option);
+    if (option_iter == section_iter->second.end()) {
+        return nullptr;
+    }
+    option_iter->second.gets.fetch_add(1, std::memory_order_relaxed);
+    return &option_iter->second;
+}
+
+void recorder::record_miss(const std::string &section, const std::string &option) const {
+    {
+        std::shared_lock<std::shared_mutex> lock(m_miss_mutex);
+        const auto section_iter = m_misses.find(section);
+        if (section_iter != m_misses.end()) {
+            const auto option_iter = section_iter->second.find(option);
+            if (option_iter != section_iter->second.end()) {
+                option_iter->second.count.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+    // checked again, another thread may have registered it in between
+    std::unique_lock<std::shared_mutex> lock(m_miss_mutex);
+    m_misses[section][option].count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void recorder::fill(config_parser::Statistics &stats) const {
+    stats.enabled = true;
+    stats.lexing_ns = m_time_ns[static_cast<int>(Phase::lexing)].value.load(std::memory_order_relaxed);
+    stats.conversion_ns = m_time_ns[static_cast<int>(Phase::conversion)].value.load(std::memory_order_relaxed);
+    stats.insertion_ns = m_time_ns[static_cast<int>(Phase::insertion)].value.load(std::memory_order_relaxed);
+    stats.lines = m_lines.load(std::memory_order_relaxed);
+
+    std::shared_lock<std::shared_mutex> lock(m_miss_mutex);
+    for (const auto &section : m_counters) {
+        auto missed_section = m_misses.find(section.first);
+        for (const auto &option : section.second) {
+            OptionStatistics option_stats;
+            option_stats.section = section.first;
+            option_stats.option = option.first;
+            option_stats.gets = option.second.gets.load(std::memory_order_relaxed);
+            option_stats.conversion_failures = option.second.conversion_failures.load(std::memory_order_relaxed);
+            stats.conversion_ns += option.second.conversion_ns.load(std::memory_order_relaxed);
+            if (missed_section != m_misses.end()) {
+                auto missed_option = missed_section->second.find(option.first);
+                if (missed_option != missed_section->second.end()) {
+                    const auto misses = missed_option->second.count.load(std::memory_order_relaxed);
+                    option_stats.gets += misses;  // a miss is a get call as well
+                    option_stats.misses = misses;
+                }
+            }
+            stats.per_option.push_back(option_stats);
+        }
+    }
+    for (const auto &section : m_misses) {
+        auto registered_section = m_counters.find(section.first);
+        for (const auto &option : section.second) {
+            if (registered_section != m_counters.end() &&
+                registered_section->second.find(option.first) != registered_section->second.end()) {
+                continue;
+            }
+            OptionStatistics option_stats;
+            option_stats.section = section.first;
+            option_stats.option = option.first;
+            option_stats.gets = option.second.count.load(std::memory_order_relaxed);
+            option_stats.misses = option_stats.gets;
+            stats.per_option.push_back(option_stats);
+        }
+    }
+
+    for (const auto &option : stats.per_option) {
+        stats.gets += option.gets;
+        stats.misses += option.misses;
+        stats.conversion_failures += option.conversion_failures;
+    }
+}
+#endif
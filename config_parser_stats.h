@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace config_parser {
+
+// lookup counters of a single option
+struct OptionStatistics {
+    std::string section;
+    std::string option;
+    std::uint64_t gets{0};
+    std::uint64_t misses{0};
+    std::uint64_t conversion_failures{0};
+};
+
+// Snapshot of what a parser costs. Storage figures are always filled in, timings and
+// counters only if the library was built with CONFIG_PARSER_STATS.
+struct Statistics {
+    bool enabled{false};
+
+    std::uint64_t lexing_ns{0};
+    std::uint64_t conversion_ns{0};
+    std::uint64_t insertion_ns{0};
+    std::uint64_t lines{0};
+
+    std::size_t sections{0};
+    std::size_t options{0};
+    std::size_t key_bytes{0};
+    std::size_t value_bytes{0};
+    float section_load_factor{0.f};
+    float option_load_factor{0.f};  // mean over all sections
+
+    std::uint64_t gets{0};
+    std::uint64_t misses{0};
+    std::uint64_t conversion_failures{0};
+    std::vector<OptionStatistics> per_option;
+
+    std::string to_text() const;
+
+    std::string to_json() const;
+};
+
+#ifdef CONFIG_PARSER_STATS
+// Collects the counters behind Statistics. Recording is const and uses relaxed atomics,
+// so concurrent readers of a parser do not contend on the hit path.
+class StatisticsRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Phase { lexing = 0, conversion, insertion };
+
+    struct Counters {
+        Counters() = default;
+
+        Counters(const Counters &other) noexcept;
+
+        std::atomic<std::uint64_t> gets{0};
+        std::atomic<std::uint64_t> conversion_failures{0};
+        std::atomic<std::uint64_t> conversion_ns{0};  // kept per option, so readers do not share it
+    };
+
+    // adds the time of its scope to a phase, or to the conversion time of one option
+    class ScopedTimer {
+    public:
+        ScopedTimer(const StatisticsRecorder &recorder, Phase phase)
+                : m_time_ns(recorder.m_time_ns[static_cast<int>(phase)].value), m_start(Clock::now()) {}
+
+        ScopedTimer(const StatisticsRecorder &recorder, Counters *counters)
+                : m_time_ns((counters != nullptr) ? counters->conversion_ns
+                                                  : recorder.m_time_ns[static_cast<int>(Phase::conversion)].value),
+                  m_start(Clock::now()) {}
+
+        ScopedTimer(const ScopedTimer&) = delete;
+
+        ~ScopedTimer() { add_time(m_time_ns, Clock::now() - m_start); }
+
+    private:
+        std::atomic<std::uint64_t> &m_time_ns;
+        Clock::time_point m_start;
+    };
+
+    StatisticsRecorder() = default;
+
+    StatisticsRecorder(const StatisticsRecorder &other);
+
+    StatisticsRecorder &operator=(const StatisticsRecorder &other);
+
+    // writers only, must not run concurrently with any lookup
+    void register_option(const std::string &section, const std::string &option);
+
+    void add_time(Phase phase, Clock::duration duration) const {
+        add_time(m_time_ns[static_cast<int>(phase)].value, duration);
+    }
+
+    void add_lines(std::uint64_t lines) { m_lines.fetch_add(lines, std::memory_order_relaxed); }
+
+    // returns nullptr if the option was never registered
+    Counters *record_get(const std::string &section, const std::string &option) const;
+
+    static void record_conversion_failure(Counters *counters) {
+        if (counters != nullptr) {
+            counters->conversion_failures.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // the counter of an option is registered on its first miss, later misses only take a shared lock
+    void record_miss(const std::string &section, const std::string &option) const;
+
+    void fill(Statistics &stats) const;
+
+private:
+    // on a cache line of its own, so that updating one phase does not contend with the others
+    struct alignas(64) PhaseTime {
+        std::atomic<std::uint64_t> value{0};
+    };
+
+    static void add_time(std::atomic<std::uint64_t> &time_ns, Clock::duration duration) {
+        time_ns.fetch_add(
+                static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()),
+                std::memory_order_relaxed);
+    }
+
+    struct MissCounter {
+        MissCounter() = default;
+
+        MissCounter(const MissCounter &other) noexcept;
+
+        std::atomic<std::uint64_t> count{0};
+    };
+
+    using CounterMap = std::unordered_map<std::string, std::unordered_map<std::string, Counters>>;
+    using MissMap = std::unordered_map<std::string, std::unordered_map<std::string, MissCounter>>;
+
+    mutable PhaseTime m_time_ns[3]{};
+    std::atomic<std::uint64_t> m_lines{0};
+    mutable CounterMap m_counters;
+
+    // misses can not be pre-registered, inserting a new one locks m_misses exclusively
+    mutable std::shared_mutex m_miss_mutex;
+    mutable MissMap m_misses;
+};
+#endif
+}
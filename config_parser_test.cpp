@@ -1,5 +1,11 @@
 #include "gtest/gtest.h"
 #include "config_parser.h"
+#include "config_parser_scan.h"
+
+#include <algorithm>
+#include <memory_resource>
+#include <random>
+#include <thread>
 
 using ConfigParser = config_parser::IniParser;
 
@@ -94,3 +100,219 @@ TEST(ConfigParser, Get) {
     EXPECT_FALSE(cfg.get<bool>("foo", "bool"));
     EXPECT_FALSE(cfg.get<bool>("foo", "nobool", false));
 }
+
+TEST(ConfigParser, StatisticsStorage) {
+    std::stringstream ss{"[foo]\nbar=value\nbar2=value\n[bar]\nfoo=value"};
+    ConfigParser cfg(ss);
+
+    auto stats = cfg.statistics();
+    EXPECT_EQ(2, stats.sections);
+    EXPECT_EQ(3, stats.options);
+    EXPECT_EQ(3 + 3 + 3 + 4 + 3, stats.key_bytes);
+    EXPECT_EQ(15, stats.value_bytes);
+    EXPECT_GT(stats.section_load_factor, 0.f);
+    EXPECT_GT(stats.option_load_factor, 0.f);
+    EXPECT_NE(std::string::npos, stats.to_text().find("options: 3"));
+    EXPECT_NE(std::string::npos, stats.to_json().find("\"options\":3"));
+}
+
+#ifdef CONFIG_PARSER_STATS
+TEST(ConfigParser, StatisticsCounters) {
+    std::stringstream ss{"[foo]\nbar=value\nint=2\n"};
+    ConfigParser cfg(ss);
+
+    EXPECT_EQ("value", cfg.get<std::string>("foo", "bar"));
+    EXPECT_EQ(2, cfg.get<int>("foo", "int"));
+    EXPECT_THROW(cfg.get<int>("foo", "bar"), config_parser::ConfigParserException);
+    EXPECT_EQ(1, cfg.get<int>("foo", "missing", 1));
+    EXPECT_THROW(cfg.get<int>("missing", "bar"), config_parser::ConfigParserException);
+
+    auto stats = cfg.statistics();
+    EXPECT_TRUE(stats.enabled);
+    EXPECT_EQ(3, stats.lines);
+    EXPECT_EQ(5, stats.gets);
+    EXPECT_EQ(2, stats.misses);
+    EXPECT_EQ(1, stats.conversion_failures);
+    EXPECT_LT(0u, stats.conversion_ns);  // summed over the options
+    for (const auto &option : stats.per_option) {
+        if (option.section == "foo" && option.option == "bar") {
+            EXPECT_EQ(2, option.gets);
+            EXPECT_EQ(1, option.conversion_failures);
+        } else if (option.option == "missing") {
+            EXPECT_EQ(1, option.gets);
+            EXPECT_EQ(1, option.misses);
+        }
+    }
+    EXPECT_NE(std::string::npos, stats.to_json().find("{\"section\":\"foo\",\"option\":\"bar\",\"gets\":2"));
+
+    // concurrent readers missing the same and new options
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&cfg, i]() {
+            for (int j = 0; j < 1000; ++j) {
+                cfg.get<int>("foo", (j % 2 == 0) ? "missing" : "missing_" + std::to_string(i), 1);
+            }
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(4002, cfg.statistics().misses);
+}
+#endif
+
+TEST(ConfigParser, SubscribeOption) {
+    ConfigParser cfg;
+    std::vector<ConfigParser::ChangeList> calls;
+    auto id = cfg.subscribe("foo", "Bar", [&calls](const ConfigParser::ChangeList &changes) {
+        calls.push_back(changes);
+    });
+
+    cfg.set("foo", "bar", "value");
+    ASSERT_EQ(1, calls.size());
+    ASSERT_EQ(1, calls[0].size());
+    EXPECT_EQ(ConfigParser::Change::Kind::added, calls[0][0].kind);
+    EXPECT_EQ("foo", calls[0][0].section);
+    EXPECT_EQ("bar", calls[0][0].option);
+
+    cfg.set("foo", "bar", "value");  // unchanged
+    cfg.set("foo", "other", "value");
+    cfg.set("other", "bar", "value");
+    EXPECT_EQ(1, calls.size());
+
+    cfg.set("FOO", "BAR", 2);
+    ASSERT_EQ(2, calls.size());
+    EXPECT_EQ(ConfigParser::Change::Kind::modified, calls[1][0].kind);
+
+    cfg.remove("foo", "bar");
+    ASSERT_EQ(3, calls.size());
+    EXPECT_EQ(ConfigParser::Change::Kind::removed, calls[2][0].kind);
+
+    cfg.unsubscribe(id);
+    cfg.set("foo", "bar", "value");
+    EXPECT_EQ(3, calls.size());
+    EXPECT_THROW(cfg.unsubscribe(id), config_parser::ConfigParserException);
+}
+
+TEST(ConfigParser, SubscribeParseIsCoalesced) {
+    ConfigParser cfg;
+    cfg.set("foo", "kept", "1");
+    cfg.set("foo", "changed", "1");
+    cfg.set("foo", "gone", "1");
+
+    std::vector<ConfigParser::ChangeList> section_calls;
+    std::vector<ConfigParser::ChangeList> prefix_calls;
+    cfg.subscribe("foo", [&section_calls](const ConfigParser::ChangeList &changes) {
+        section_calls.push_back(changes);
+    });
+    cfg.subscribe_prefix("foo", "new", [&prefix_calls](const ConfigParser::ChangeList &changes) {
+        prefix_calls.push_back(changes);
+    });
+
+    cfg.parse_string("[foo]\nkept=1\nchanged=2\nchanged=3\nnew_a=1\nnew_b=1\nnew_b=2\n[bar]\nx=1\n");
+    ASSERT_EQ(1, section_calls.size());
+    EXPECT_EQ(3, section_calls[0].size());
+    ASSERT_EQ(1, prefix_calls.size());
+    ASSERT_EQ(2, prefix_calls[0].size());
+    for (const auto &change : prefix_calls[0]) {
+        EXPECT_EQ(ConfigParser::Change::Kind::added, change.kind);
+    }
+
+    cfg.remove("foo");
+    ASSERT_EQ(2, section_calls.size());
+    EXPECT_EQ(5, section_calls[1].size());
+    ASSERT_EQ(2, prefix_calls.size());
+    EXPECT_EQ(2, prefix_calls[1].size());
+}
+
+TEST(ConfigParser, ParseSyntax) {
+    ConfigParser cfg;
+    cfg.parse_string("; comment = with assignment\r\n"
+                     "top = level\r\n"
+                     "  [Section One]  \r\n"
+                     "\t# another comment\n"
+                     "Key=  some value with  spaces ; kept  \n"
+                     "url = http://host/#anchor\n"
+                     "\n"
+                     "last = no newline");
+    EXPECT_EQ("level", cfg.get<std::string>("", "top"));
+    EXPECT_EQ("some value with  spaces ; kept", cfg.get<std::string>("section one", "key"));
+    EXPECT_EQ("http://host/#anchor", cfg.get<std::string>("Section One", "url"));
+    EXPECT_EQ("no newline", cfg.get<std::string>("section one", "last"));
+
+    EXPECT_THROW(cfg.parse_string("no assignment"), config_parser::ConfigParserException);
+    EXPECT_THROW(cfg.parse_string("= value"), config_parser::ConfigParserException);
+    EXPECT_THROW(cfg.parse_string("key ="), config_parser::ConfigParserException);
+    EXPECT_THROW(cfg.parse_string("two keys = value"), config_parser::ConfigParserException);
+    EXPECT_THROW(cfg.parse_string("[]"), config_parser::ConfigParserException);
+    EXPECT_THROW(cfg.parse_string("[a]b]"), config_parser::ConfigParserException);
+    EXPECT_THROW(cfg.parse_string("[open"), config_parser::ConfigParserException);
+}
+
+TEST(ConfigParser, ScannerKernelsAgree) {
+    std::mt19937 generator(42);
+    const std::string alphabet = "ab =[];#\n\t";
+    std::string text(4099, ' ');
+    for (auto &c : text) {
+        c = alphabet[generator() % alphabet.size()];
+    }
+
+    std::vector<std::size_t> expected;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\n' || text[i] == '=' || text[i] == '[' || text[i] == ';' || text[i] == '#') {
+            expected.push_back(i);
+        }
+    }
+
+    using Scanner = config_parser::StructuralScanner;
+    for (auto kernel : {Scanner::Kernel::scalar, Scanner::Kernel::sse2, Scanner::Kernel::avx2}) {
+        for (auto size : {std::size_t(0), std::size_t(63), std::size_t(64), std::size_t(65), text.size()}) {
+            Scanner scanner(text.data(), size, kernel);
+            std::vector<std::size_t> found;
+            for (auto position = scanner.next(); position != size; position = scanner.next()) {
+                found.push_back(position);
+            }
+            std::vector<std::size_t> expected_prefix(expected.begin(),
+                                                     std::lower_bound(expected.begin(), expected.end(), size));
+            EXPECT_EQ(expected_prefix, found);
+            EXPECT_EQ(size, scanner.next());
+        }
+    }
+}
+
+TEST(ConfigParser, MemoryResource) {
+    // counts what the parser asks of its resource, the global one must not be touched
+    struct CountingResource : std::pmr::memory_resource {
+        std::size_t allocations = 0;
+
+        void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+            ++allocations;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+    };
+    CountingResource upstream;
+    std::pmr::monotonic_buffer_resource arena(&upstream);
+    auto previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+
+    {
+        config_parser::PmrIniParser cfg(&arena);
+        cfg.parse_string("[Foo]\nbar = 42\nbaz = a value that does not fit into a small string\n");
+        cfg.set("foo", "flag", true);
+
+        EXPECT_EQ(&arena, cfg.get_allocator().resource());
+        EXPECT_EQ(&arena, cfg.items("foo").get_allocator().resource());
+        EXPECT_EQ(42, cfg.get<int>("foo", "bar"));
+        EXPECT_EQ("a value that does not fit into a small string", cfg.get<std::string>("FOO", "baz"));
+        EXPECT_TRUE(cfg.get<bool>("foo", "flag"));
+        EXPECT_EQ(std::vector<std::string>{"foo"}, cfg.sections());
+        EXPECT_THROW(cfg.parse_string("[foo\n"), config_parser::ConfigParserException);
+    }
+    std::pmr::set_default_resource(previous);
+    EXPECT_GT(upstream.allocations, 0u);
+}
@@ -0,0 +1,101 @@
+#include "layered_config.h"
+
+using lc = utils::layered_config;
+
+lc::layered_config(const utils::argument_parser& parser, const config_parser::IniParser& config)
+        : m_parser(parser), m_config(config) {}
+
+lc::layered_config(const utils::argument_parser& parser, const utils::argument_parser::Result& result,
+                   const config_parser::IniParser& config)
+        : m_parser(parser), m_result(&result), m_config(config) {}
+
+void lc::bind(const lc::OptionNameType& name, const std::string& section, const std::string& option) {
+    if (!m_parser.has_option(name)) {
+        throw UsageException("Option '" + name + "' does not exist.");
+    }
+    if (m_parser.number_of_arguments(name) > 1) {
+        throw UsageException("Option '" + name + "' has several arguments and can not be bound");
+    }
+    if (m_parser.has_callback(name)) {
+        throw UsageException("Option '" + name + "' hands its values to a callback and can not be bound");
+    }
+    const auto position = m_parser.find_option_position(name);
+    if (m_bindings.count(position) == 0) {
+        m_bound_names.push_back(name);
+    }
+    m_bindings[position] = {section, option};
+    m_sources.erase(position);
+}
+
+lc::value_source lc::source(const lc::OptionNameType& name) const {
+    return source(m_parser.find_option_position(name), name);
+}
+
+lc::value_source lc::source(std::size_t position, const lc::OptionNameType& name) const {
+    const auto cached = m_sources.find(position);
+    if (cached != m_sources.end()) {
+        return cached->second;
+    }
+
+    auto source = value_source::unset;
+    const auto binding = m_bindings.find(position);
+    if (is_parsed(name)) {
+        source = value_source::arguments;
+    } else if ((binding != m_bindings.end()) && m_config.has(binding->second.section, binding->second.option)) {
+        source = value_source::config_file;
+    } else if (m_parser.has_default(name)) {
+        source = value_source::default_value;
+    }
+    m_sources.emplace(position, source);
+    return source;
+}
+
+void lc::reset() {
+    m_sources.clear();
+}
+
+std::string lc::help() const {
+    std::string text = m_parser.help();
+    if (m_bound_names.empty()) {
+        return text;
+    }
+
+    text += "\n\nValues:\n";
+    for (const auto& name : m_bound_names) {
+        const auto position = m_parser.find_option_position(name);
+        const auto& key = m_bindings.at(position);
+        const auto origin = source(position, name);
+        text += " " + name + " =";
+        // a callback set after bind() consumed the values of the parser
+        const auto is_consumed = (origin != value_source::config_file) && m_parser.has_callback(name);
+        if ((origin != value_source::unset) && !is_consumed) {
+            for (const auto& value : get_n<std::string>(name)) {
+                text += " " + value;
+            }
+        }
+        text += std::string(" (") + to_string(origin);
+        if (origin == value_source::config_file) {
+            text += ": [" + key.section + "] " + key.option;
+        }
+        text += ")\n";
+    }
+    text.pop_back();
+    return text;
+}
+
+const char* lc::to_string(lc::value_source source) {
+    switch (source) {
+        case value_source::arguments:
+            return "arguments";
+        case value_source::config_file:
+            return "config file";
+        case value_source::default_value:
+            return "default";
+        default:
+            return "unset";
+    }
+}
+
+bool lc::is_parsed(const lc::OptionNameType& name) const {
+    return (m_result != nullptr) ? m_result->is_parsed(name) : m_parser.is_parsed(name);
+}
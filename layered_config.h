@@ -0,0 +1,89 @@
+/**
+ * Combines the values of an argument_parser and an IniParser without copying one into the other.
+ *
+ * Options are bound to a (section, option) key of the configuration. Their values are looked up
+ * on demand in the order:
+ *   - command line (including environment variables bound to the option)
+ *   - configuration file
+ *   - default value of the option
+ *
+ * The sources are cached by const lookups, so a layered_config must not be used by several
+ * threads at once.
+ */
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "argument_parser.h"
+#include "config_parser.h"
+
+namespace utils {
+
+class layered_config {
+public:
+    using OptionNameType = argument_parser::OptionNameType;
+
+    enum class value_source { arguments, config_file, default_value, unset };
+
+    // both have to outlive the layered_config, the arguments are those of the last parse()
+    layered_config(const argument_parser& parser, const config_parser::IniParser& config);
+
+    layered_config(const argument_parser& parser, const argument_parser::Result& result,
+                   const config_parser::IniParser& config);
+
+    // Any name of the option can be bound and read. Options with several arguments can not be
+    // bound, a configuration value is a single argument. Neither can options whose values go to
+    // a callback, they are not stored for get().
+    void bind(const OptionNameType& name, const std::string& section, const std::string& option);
+
+    // Resolved once per option and then cached, call reset() after parsing again or changing
+    // the configuration.
+    value_source source(const OptionNameType& name) const;
+
+    void reset();
+
+    template<typename T>
+    T get(const OptionNameType& name) const {
+        const auto position = m_parser.find_option_position(name);
+        if (source(position, name) == value_source::config_file) {
+            const auto& key = m_bindings.at(position);
+            return m_config.get<T>(key.section, key.option);
+        }
+        return (m_result != nullptr) ? m_result->get<T>(name) : m_parser.get<T>(name);
+    }
+
+    template<typename T>
+    std::vector<T> get_n(const OptionNameType& name) const {
+        if (source(name) == value_source::config_file) {
+            return {get<T>(name)};  // bound options have a single argument
+        }
+        return (m_result != nullptr) ? m_result->get_n<T>(name) : m_parser.get_n<T>(name);
+    }
+
+    // help() of the parser followed by the effective value and its source of each bound option
+    std::string help() const;
+
+    static const char* to_string(value_source source);
+
+private:
+    struct Key {
+        std::string section;
+        std::string option;
+    };
+
+    value_source source(std::size_t position, const OptionNameType& name) const;
+
+    bool is_parsed(const OptionNameType& name) const;
+
+    const argument_parser& m_parser;
+    const argument_parser::Result* m_result{nullptr};
+    const config_parser::IniParser& m_config;
+    std::vector<OptionNameType> m_bound_names;  // in the order of bind()
+    // by the position of the option in the parser, so that all of its names find them
+    std::unordered_map<std::size_t, Key> m_bindings;
+    mutable std::unordered_map<std::size_t, value_source> m_sources;
+};
+
+} // namespace utils
@@ -0,0 +1,101 @@
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "layered_config.h"
+
+using ArgumentParser = utils::argument_parser;
+using ConfigParser = config_parser::IniParser;
+using LayeredConfig = utils::layered_config;
+
+namespace {
+void add_options(ArgumentParser& parser) {
+    parser.add_option<int>({"-j", "--jobs"}, "parallel jobs", "N", "1");
+    parser.add_option({"--output"}, "output file", "FILE", "a.out");
+    parser.add_option({"--name"}, "name");
+    parser.add_flag({"-v", "--verbose"}, "verbose");
+    parser.add_option({"--size"}, 2, "width and height", {"W", "H"}, {"1", "1"});
+}
+}
+
+TEST(LayeredConfig, Precedence) {
+    ArgumentParser parser;
+    add_options(parser);
+    ConfigParser config;
+    config.set("build", "jobs", 4);
+    config.set("build", "output", "build.out");
+    config.set("general", "verbose", true);
+    int bound{0};
+    parser.add_option<int>({"--bound"}, "handed to a callback", "N", "3");
+    parser.bind("bound", bound);
+
+    ASSERT_NO_THROW(parser.parse({"app", "--output", "cli.out"}));
+    LayeredConfig layered(parser, config);
+    layered.bind("jobs", "build", "jobs");
+    layered.bind("output", "build", "output");
+    layered.bind("verbose", "general", "verbose");
+    layered.bind("name", "general", "name");
+    EXPECT_THROW(layered.bind("missing", "general", "missing"), utils::UsageException);
+    EXPECT_THROW(layered.bind("size", "build", "size"), utils::UsageException);
+    EXPECT_THROW(layered.bind("bound", "build", "bound"), utils::UsageException);
+
+    EXPECT_EQ(4, layered.get<int>("jobs"));
+    EXPECT_EQ(LayeredConfig::value_source::config_file, layered.source("jobs"));
+    EXPECT_EQ(4, layered.get<int>("-j"));
+    EXPECT_EQ(4, layered.get<int>("--jobs"));
+    EXPECT_EQ(std::vector<int>({4}), layered.get_n<int>("j"));
+    EXPECT_EQ(LayeredConfig::value_source::config_file, layered.source("--jobs"));
+    EXPECT_EQ("cli.out", layered.get<std::string>("output"));
+    EXPECT_EQ(LayeredConfig::value_source::arguments, layered.source("output"));
+    EXPECT_TRUE(layered.get<bool>("verbose"));
+    EXPECT_EQ(LayeredConfig::value_source::unset, layered.source("name"));
+    EXPECT_THROW(layered.get<std::string>("name"), utils::ParsingException);
+    EXPECT_EQ(LayeredConfig::value_source::default_value, layered.source("bound"));
+    EXPECT_EQ(3, bound);
+
+    // not bound, only the parser is asked
+    ArgumentParser::Result result;
+    ASSERT_NO_THROW(parser.parse({"app", "-j", "2"}, result));
+    LayeredConfig from_result(parser, result, config);
+    from_result.bind("output", "build", "output");
+    EXPECT_EQ(2, from_result.get<int>("jobs"));
+    EXPECT_EQ(std::vector<std::string>({"build.out"}), from_result.get_n<std::string>("output"));
+    EXPECT_EQ(LayeredConfig::value_source::default_value, from_result.source("verbose"));
+
+    // sources are cached until reset()
+    config.remove("build", "output");
+    EXPECT_EQ(LayeredConfig::value_source::config_file, from_result.source("output"));
+    from_result.reset();
+    EXPECT_EQ("a.out", from_result.get<std::string>("output"));
+    EXPECT_EQ(LayeredConfig::value_source::default_value, from_result.source("output"));
+}
+
+TEST(LayeredConfig, Help) {
+    ArgumentParser parser;
+    add_options(parser);
+    parser.set_program_info("app");
+    ConfigParser config;
+    config.set("build", "jobs", 4);
+    parser.add_option({"--tag"}, "handed to a callback once bound");
+
+    LayeredConfig layered(parser, config);
+    EXPECT_EQ(parser.help(), layered.help());
+
+    layered.bind("jobs", "build", "jobs");
+    layered.bind("name", "general", "name");
+    layered.bind("output", "build", "output");
+    layered.bind("verbose", "general", "verbose");
+    layered.bind("tag", "general", "tag");
+    std::string tag;
+    parser.bind("tag", tag);
+    ASSERT_NO_THROW(parser.parse({"app", "--name", "x", "--tag", "t"}));
+    const std::string expected_values =
+            "\n\nValues:\n"
+            " jobs = 4 (config file: [build] jobs)\n"
+            " name = x (arguments)\n"
+            " output = a.out (default)\n"
+            " verbose = false (default)\n"
+            " tag = (arguments)";
+    EXPECT_EQ(parser.help() + expected_values, layered.help());
+    EXPECT_EQ("t", tag);
+}